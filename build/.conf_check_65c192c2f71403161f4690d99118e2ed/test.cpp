@@ -0,0 +1 @@
+int main() { bool flag; }
\ No newline at end of file
@@ -0,0 +1,2 @@
+#include <cstdio> 
+ int main() { printf("%zu", sizeof(int)); }
\ No newline at end of file
@@ -0,0 +1,69 @@
+AR = '/usr/bin/ar'
+ARFLAGS = 'rcs'
+BINDIR = '/usr/local/bin'
+CC = ['/usr/bin/gcc']
+CCLNK_SRC_F = []
+CCLNK_TGT_F = ['-o']
+CC_NAME = 'gcc'
+CC_SRC_F = []
+CC_TGT_F = ['-c', '-o']
+CC_VERSION = ('12', '2', '0')
+CFLAGS = ['-Wall', '-ggdb', '-std=c99', '-O3', '-ffast-math', '-fPIC']
+CFLAGS_MACBUNDLE = ['-fPIC']
+CFLAGS_cshlib = ['-fPIC']
+COMPILER_CC = 'gcc'
+COMPILER_CXX = 'g++'
+CPPPATH_ST = '-I%s'
+CXX = ['/usr/bin/g++']
+CXXFLAGS = ['-Wall', '-ggdb', '-O3', '-ffast-math', '-fPIC']
+CXXFLAGS_MACBUNDLE = ['-fPIC']
+CXXFLAGS_cxxshlib = ['-fPIC']
+CXXLNK_SRC_F = []
+CXXLNK_TGT_F = ['-o']
+CXX_NAME = 'gcc'
+CXX_SRC_F = []
+CXX_TGT_F = ['-c', '-o']
+DEFINES = []
+DEFINES_ST = '-D%s'
+DEST_BINFMT = 'elf'
+DEST_CPU = 'x86_64'
+DEST_OS = 'linux'
+HAVE_BOOL = 0
+HAVE_LV2 = 0
+HAVE_LV2CORE = 0
+INCLUDES_LV2 = ['/tmp/stub']
+INCLUDES_LV2CORE = ['/tmp/stub']
+LIBDIR = '/usr/local/lib'
+LIBPATH_ST = '-L%s'
+LIB_M = ['m']
+LIB_PTHREAD = ['pthread']
+LIB_ST = '-l%s'
+LINKFLAGS_MACBUNDLE = ['-bundle', '-undefined', 'dynamic_lookup']
+LINKFLAGS_cshlib = ['-shared']
+LINKFLAGS_cstlib = ['-Wl,-Bstatic']
+LINKFLAGS_cxxshlib = ['-shared']
+LINKFLAGS_cxxstlib = ['-Wl,-Bstatic']
+LINK_CC = ['/usr/bin/gcc']
+LINK_CXX = ['/usr/bin/g++']
+LV2DIR = '/usr/local/lib/lv2'
+PERL = '/usr/bin/perl'
+PKGCONFIG = '/usr/bin/pkg-config'
+PLUGINS = ['envelope_generator', 'lb303', 'sidemu', 'triple_oscillator']
+PREFIX = '/usr/local'
+RPATH_ST = '-Wl,-rpath,%s'
+SHLIB_MARKER = '-Wl,-Bdynamic'
+SONAME_ST = '-Wl,-h,%s'
+STLIBPATH_ST = '-L%s'
+STLIB_MARKER = '-Wl,-Bstatic'
+STLIB_ST = '-l%s'
+TTL2PORTFILE = '/tmp/ttl2port.sh'
+cfg_files = ['/root/repo/build/src/config.h']
+cprogram_PATTERN = '%s'
+cshlib_PATTERN = 'lib%s.so'
+cstlib_PATTERN = 'lib%s.a'
+cxxprogram_PATTERN = '%s'
+cxxshlib_PATTERN = 'lib%s.so'
+cxxstlib_PATTERN = 'lib%s.a'
+define_key = []
+macbundle_PATTERN = '%s.bundle'
+pluginlib_PATTERN = '%s.so'
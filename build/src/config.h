@@ -0,0 +1,12 @@
+/* WARNING! All changes made to this file will be lost! */
+
+#ifndef _SRC_CONFIG_H_WAF
+#define _SRC_CONFIG_H_WAF
+
+#define HAVE_LV2CORE 1
+#define HAVE_LV2 1
+#define HAVE_BOOL 1
+#define NUM_VOICES 128
+#define TILE_SIZE 64
+
+#endif /* _SRC_CONFIG_H_WAF */
@@ -0,0 +1,8 @@
+#ifndef INSTRUMENT_PORTS_H__
+#define INSTRUMENT_PORTS_H__
+enum {
+	PORT_CONTROL	 = 0,
+	PORT_OUT_L	 = 1,
+	PORT_OUT_R	 = 2,
+};
+#endif
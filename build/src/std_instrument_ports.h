@@ -0,0 +1,60 @@
+#ifndef STD_INSTRUMENT_PORTS_H__
+#define STD_INSTRUMENT_PORTS_H__
+enum {
+	PORT_ENV_VOL_DEL	 = 32,
+	PORT_ENV_VOL_ATT	 = 33,
+	PORT_ENV_VOL_HOLD	 = 34,
+	PORT_ENV_VOL_DEC	 = 35,
+	PORT_ENV_VOL_SUS	 = 36,
+	PORT_ENV_VOL_REL	 = 37,
+	PORT_ENV_VOL_MOD	 = 38,
+	PORT_LFO_VOL_DEL	 = 39,
+	PORT_LFO_VOL_ATT	 = 40,
+	PORT_LFO_VOL_SPD	 = 41,
+	PORT_LFO_VOL_SHAPE	 = 42,
+	PORT_LFO_VOL_MOD	 = 43,
+	PORT_LFO_VOL_OP	 = 44,
+	PORT_FILTER_ENABLED	 = 45,
+	PORT_FILTER_TYPE	 = 46,
+	PORT_FILTER_CUT	 = 47,
+	PORT_FILTER_RES	 = 48,
+	PORT_ENV_CUT_DEL	 = 49,
+	PORT_ENV_CUT_ATT	 = 50,
+	PORT_ENV_CUT_HOLD	 = 51,
+	PORT_ENV_CUT_DEC	 = 52,
+	PORT_ENV_CUT_SUS	 = 53,
+	PORT_ENV_CUT_REL	 = 54,
+	PORT_ENV_CUT_MOD	 = 55,
+	PORT_LFO_CUT_DEL	 = 56,
+	PORT_LFO_CUT_ATT	 = 57,
+	PORT_LFO_CUT_SPD	 = 58,
+	PORT_LFO_CUT_SHAPE	 = 59,
+	PORT_LFO_CUT_MOD	 = 60,
+	PORT_LFO_CUT_OP	 = 61,
+	PORT_ENV_RES_DEL	 = 62,
+	PORT_ENV_RES_ATT	 = 63,
+	PORT_ENV_RES_HOLD	 = 64,
+	PORT_ENV_RES_DEC	 = 65,
+	PORT_ENV_RES_SUS	 = 66,
+	PORT_ENV_RES_REL	 = 67,
+	PORT_ENV_RES_MOD	 = 68,
+	PORT_LFO_RES_DEL	 = 69,
+	PORT_LFO_RES_ATT	 = 70,
+	PORT_LFO_RES_SPD	 = 71,
+	PORT_LFO_RES_SHAPE	 = 72,
+	PORT_LFO_RES_MOD	 = 73,
+	PORT_LFO_RES_OP	 = 74,
+	PORT_CULL_THRESHOLD	 = 75,
+	PORT_POLYPHONY	 = 76,
+	PORT_PIPELINE	 = 77,
+	PORT_LATENCY	 = 78,
+	PORT_EVENT_GRID	 = 79,
+	PORT_FM_OVERSAMPLE	 = 80,
+	PORT_QUALITY	 = 81,
+	PORT_GOVERNOR	 = 82,
+	PORT_LOAD	 = 83,
+	PORT_FREEWHEEL	 = 84,
+	PORT_VOICE_MODE	 = 85,
+	PORT_ACTIVE_VOICES	 = 86,
+};
+#endif
@@ -0,0 +1,34 @@
+#ifndef TRIPLE_OSCILLATOR_PORTS_H__
+#define TRIPLE_OSCILLATOR_PORTS_H__
+enum {
+	PORT_OSC1_VOL	 = 3,
+	PORT_OSC1_PAN	 = 4,
+	PORT_OSC1_DETUNE_COARSE	 = 5,
+	PORT_OSC1_DETUNE_FINE_L	 = 6,
+	PORT_OSC1_DETUNE_FINE_R	 = 7,
+	PORT_OSC1_PHASE_OFFSET	 = 8,
+	PORT_OSC1_PHASE_DETUNE	 = 9,
+	PORT_OSC1_PHASE_RANDOM	 = 10,
+	PORT_OSC1_WAVE_SHAPE	 = 11,
+	PORT_OSC1_OSC2_MOD	 = 12,
+	PORT_OSC2_VOL	 = 13,
+	PORT_OSC2_PAN	 = 14,
+	PORT_OSC2_DETUNE_COARSE	 = 15,
+	PORT_OSC2_DETUNE_FINE_L	 = 16,
+	PORT_OSC2_DETUNE_FINE_R	 = 17,
+	PORT_OSC2_PHASE_OFFSET	 = 18,
+	PORT_OSC2_PHASE_DETUNE	 = 19,
+	PORT_OSC2_PHASE_RANDOM	 = 20,
+	PORT_OSC2_WAVE_SHAPE	 = 21,
+	PORT_OSC2_OSC3_MOD	 = 22,
+	PORT_OSC3_VOL	 = 23,
+	PORT_OSC3_PAN	 = 24,
+	PORT_OSC3_DETUNE_COARSE	 = 25,
+	PORT_OSC3_DETUNE_FINE_L	 = 26,
+	PORT_OSC3_DETUNE_FINE_R	 = 27,
+	PORT_OSC3_PHASE_OFFSET	 = 28,
+	PORT_OSC3_PHASE_DETUNE	 = 29,
+	PORT_OSC3_PHASE_RANDOM	 = 30,
+	PORT_OSC3_WAVE_SHAPE	 = 31,
+};
+#endif
@@ -73,6 +73,45 @@ blep_init (float *blep, float *blamp, int n)
 }
 
 
+// Modified Bessel function of the first kind, order 0
+static double
+bessel_i0 (double x)
+{
+	double sum  = 1.0;
+	double term = 1.0;
+	int k;
+
+	for (k = 1; k < 32; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum  += term;
+	}
+	return sum;
+}
+
+
+// Kaiser windowed sinc lowpass for decimating by factor, cut off at the
+// Nyquist frequency of the lower rate.  Normalized to unity DC gain.
+void
+decim_init (float *kernel, int ntaps, int factor)
+{
+	const double beta = 7.0; // About 70dB stopband
+	const double mid  = (ntaps - 1) / 2.0;
+	double sum = 0.0;
+	double w, x;
+	int i;
+
+	for (i = 0; i < ntaps; ++i) {
+		x = (i - mid) / mid;
+		w = bessel_i0(beta * sqrt(1.0 - x * x)) / bessel_i0(beta);
+		kernel[i] = sinc((i - mid) / factor) * w;
+		sum += kernel[i];
+	}
+	for (i = 0; i < ntaps; ++i) {
+		kernel[i] /= sum;
+	}
+}
+
+
 void
 blep_state_init (BlepState* st) {
 	st->ptr = 8; // deactivate this correction-pipeline
@@ -10,5 +10,6 @@ typedef struct blep_state {
 
 void blep_init (float *blep, float *blamp, int n);
 void blep_state_init (BlepState *st);
+void decim_init (float *kernel, int ntaps, int factor);
 
 #endif // BLEP_H__
@@ -8,18 +8,6 @@
 #include "envelope.h"
 #include "lmms_math.h"
 
-// STATES
-enum {
-	ENV_OFF,        // Off
-	ENV_DEL,        // Delay
-	ENV_ATT,        // Attack
-	ENV_HOLD,       // Hold
-	ENV_DEC,        // Decay
-	ENV_SUS,        // Sustain
-	ENV_REL         // Release
-};
-
-
 // Advance envelope state to next non-zero-length section
 static void
 advance_state (EnvelopeParams *p, EnvelopeState *st)
@@ -66,152 +54,376 @@ advance_state (EnvelopeParams *p, EnvelopeState *st)
 }
 
 
-Envelope *
-envelope_create (EnvelopeParams *p)
-{
-	Envelope *e = malloc(sizeof(Envelope));
-	if (e) {
-		// Parameters made to external floats
-		e->p = p;
-
-		// State
-		e->st.q           = ENV_OFF;
-		e->st.frame       = 0;
-		e->st.nframes     = 0;	
-		e->st.rel_base    = 0;
-		e->st.last_sample = 0.0f;
-		return e;
-	}
-	return NULL;
-}
-
-
-void
-envelope_destroy (Envelope *e)
+static void
+state_init (EnvelopeState *st)
 {
-	free(e);
+	st->q           = ENV_OFF;
+	st->frame       = 0;
+	st->nframes     = 0;
+	st->rel_base    = 0;
+	st->last_sample = 0.0f;
 }
 
 
-void
-envelope_trigger (Envelope *e)
+static void
+state_trigger (EnvelopeParams *p, EnvelopeState *st)
 {
-	e->st.q = ENV_OFF;
-	advance_state(e->p, &e->st);
+	// A release before the first run starts from zero, not the last note
+	st->q           = ENV_OFF;
+	st->rel_base    = 0.0f;
+	st->last_sample = 0.0f;
+	advance_state(p, st);
 }
 
 
-void
-envelope_release (Envelope *e)
+static void
+state_release (EnvelopeParams *p, EnvelopeState *st)
 {
-	switch (e->st.q) {
+	switch (st->q) {
 	case ENV_OFF:
 	case ENV_REL:
 		break;
 	case ENV_DEL:
-		e->st.q = ENV_OFF;
+		st->q = ENV_OFF;
 		break;
 	default:
 		// Only do release if release has any length
-		if (*e->p->rel > 0.0f) {
-			e->st.q        = ENV_REL;
-			e->st.nframes  = e->p->time_base * (*e->p->rel);
-			e->st.frame    = 0;
-			e->st.rel_base = e->st.last_sample;
+		if (*p->rel > 0.0f) {
+			st->q        = ENV_REL;
+			st->nframes  = p->time_base * (*p->rel);
+			st->frame    = 0;
+			st->rel_base = st->last_sample;
 		} else {
-			e->st.q = ENV_OFF;
+			st->q = ENV_OFF;
 		}
 		break;
 	}
 }
 
 
-int
-envelope_run (Envelope *e, float *samples, uint32_t nsamples)
+static int
+state_run (EnvelopeParams *p, EnvelopeState *st, float *samples, uint32_t nsamples)
 {
 	// FIXME: Crap
 	float amsum  = 1.0f;
 	float amount = 1.0f;
 
-	int i;
-	float o = e->st.last_sample;
-	for (i=0; i<nsamples; ++i) {
-		// Stupid way
-		// (FIXME: Could use a nested loop to avoid checking case each time?)
-		switch (e->st.q) {
-		case ENV_OFF:
-			o = 0.0f;
-			break;
+	const float mod = *p->mod;
+	float o = st->last_sample;
+	uint32_t i = 0;
+
+	// Render one state section at a time.  Each section is a constant or a
+	// linear ramp, so the inner loops are simple enough to be vectorized.
+	while (i < nsamples) {
+		uint32_t len = nsamples - i;
+		uint32_t left, f;
+		float slope;
 
+		switch (st->q) {
 		case ENV_DEL:
-			// Process
-			o = 0.0f;
-			// State change
-			e->st.frame++;
-			if (e->st.frame > e->st.nframes) {
-				advance_state(e->p, &e->st);
+		case ENV_HOLD:
+			// Sections last nframes+1 frames
+			left = st->nframes + 1 - st->frame;
+			len  = q_min(len, left);
+			o    = (st->q == ENV_HOLD) ? 1.0f : 0.0f;
+			for (f = 0; f < len; ++f) {
+				samples[i+f] = o * mod;
+			}
+			st->frame += len;
+			if (len == left) {
+				advance_state(p, st);
 			}
 			break;
 
 		case ENV_ATT:
-			// Process
-			o = ((float)e->st.frame) / (e->st.nframes);
-			// State
-			e->st.frame++;
-			if (e->st.frame >= e->st.nframes) {
-				advance_state(e->p, &e->st);
+			left = (st->frame + 1 >= st->nframes) ? 1 : st->nframes - st->frame;
+			len  = q_min(len, left);
+			for (f = 0; f < len; ++f) {
+				samples[i+f] = ((float)(st->frame + f)) / (st->nframes) * mod;
 			}
-			break;
-
-		case ENV_HOLD:
-			// Process
-			o = 1.0f;
-			// State
-			e->st.frame++;
-			if (e->st.frame > e->st.nframes) {
-				advance_state(e->p, &e->st);
+			o = ((float)(st->frame + len - 1)) / (st->nframes);
+			st->frame += len;
+			if (len == left) {
+				advance_state(p, st);
 			}
 			break;
 
 		case ENV_DEC:
-			// Process
-			o = amsum + e->st.frame * ((1.0f / e->st.nframes)*((*e->p->sus)-1.0f)*amount);
+			left  = st->nframes + 1 - st->frame;
+			len   = q_min(len, left);
+			slope = (1.0f / st->nframes)*((*p->sus)-1.0f)*amount;
+			for (f = 0; f < len; ++f) {
+				samples[i+f] = (amsum + (st->frame + f) * slope) * mod;
+			}
+			o = amsum + (st->frame + len - 1) * slope;
 			//o = 1.0f - (1.0f - (*eg->sus_port)) * ((float)e->st.frame / e->st.nframes);
-			//State
-			e->st.frame++;
-			if (e->st.frame > e->st.nframes) {
-				advance_state(e->p, &e->st);
+			st->frame += len;
+			if (len == left) {
+				advance_state(p, st);
 			}
 			break;
 
 		case ENV_SUS:
-			o = *e->p->sus; // Sustain Level;
+			o = *p->sus; // Sustain Level;
+			for (f = 0; f < len; ++f) {
+				samples[i+f] = o * mod;
+			}
 			break;
 
 		case ENV_REL:
-			// Process
-			o = e->st.rel_base * (1.0f - ((float)e->st.frame / e->st.nframes));
-			// State
-			e->st.frame++;
-			if (e->st.frame >= e->st.nframes) {
-				e->st.q = ENV_OFF;
+			left = (st->frame + 1 >= st->nframes) ? 1 : st->nframes - st->frame;
+			len  = q_min(len, left);
+			for (f = 0; f < len; ++f) {
+				samples[i+f] = st->rel_base * (1.0f - ((float)(st->frame + f) / st->nframes)) * mod;
+			}
+			o = st->rel_base * (1.0f - ((float)(st->frame + len - 1) / st->nframes));
+			st->frame += len;
+			if (len == left) {
+				st->q = ENV_OFF;
 			}
 			break;
 
+		case ENV_OFF:
 		default:
+			o = 0.0f;
+			for (f = 0; f < len; ++f) {
+				samples[i+f] = 0.0f;
+			}
 			break;
 		}
 
-		float mod = *e->p->mod;
-		//if (mod >= 0.0f) {
-			samples[i] = o * mod;
-		//}
-		//else {
-			// TODO: Negative mod
-		//}
+		// TODO: Negative mod
+		i += len;
 	}
-	e->st.last_sample = o;
+	st->last_sample = o;
 
 	// Return 1 if envelope is still active
-	return e->st.q != ENV_OFF;
+	return st->q != ENV_OFF;
+}
+
+
+Envelope *
+envelope_create (EnvelopeParams *p)
+{
+	Envelope *e = malloc(sizeof(Envelope));
+	if (e) {
+		// Parameters made to external floats
+		e->p = p;
+		state_init(&e->st);
+		return e;
+	}
+	return NULL;
 }
+
+
+void
+envelope_destroy (Envelope *e)
+{
+	free(e);
+}
+
+
+void
+envelope_trigger (Envelope *e)
+{
+	state_trigger(e->p, &e->st);
+}
+
+
+void
+envelope_release (Envelope *e)
+{
+	state_release(e->p, &e->st);
+}
+
+
+int
+envelope_run (Envelope *e, float *samples, uint32_t nsamples)
+{
+	return state_run(e->p, &e->st, samples, nsamples);
+}
+
+
+//// Envelope banks
+
+
+// Gather a lane into a scalar state so it can be run in registers
+static inline void
+bank_load (EnvelopeBank *b, uint32_t lane, EnvelopeState *st)
+{
+	st->q           = b->q[lane];
+	st->frame       = b->frame[lane];
+	st->nframes     = b->nframes[lane];
+	st->rel_base    = b->rel_base[lane];
+	st->last_sample = b->last_sample[lane];
+}
+
+
+static inline void
+bank_store (EnvelopeBank *b, uint32_t lane, const EnvelopeState *st)
+{
+	b->q[lane]           = st->q;
+	b->frame[lane]       = st->frame;
+	b->nframes[lane]     = st->nframes;
+	b->rel_base[lane]    = st->rel_base;
+	b->last_sample[lane] = st->last_sample;
+}
+
+
+EnvelopeBank *
+envelope_bank_create (EnvelopeParams *p, uint32_t nlanes)
+{
+	// One allocation for the bank and all of its lanes
+	EnvelopeBank *b = malloc(sizeof(EnvelopeBank) + nlanes *
+	                         (sizeof(int) + sizeof(uint32_t) * 2 + sizeof(float) * 2));
+	EnvelopeState st;
+	uint32_t i;
+
+	if (!b) {
+		return NULL;
+	}
+
+	b->p           = p;
+	b->nlanes      = nlanes;
+	b->q           = (int *)(b + 1);
+	b->frame       = (uint32_t *)(b->q + nlanes);
+	b->nframes     = b->frame + nlanes;
+	b->rel_base    = (float *)(b->nframes + nlanes);
+	b->last_sample = b->rel_base + nlanes;
+
+	state_init(&st);
+	for (i = 0; i < nlanes; ++i) {
+		bank_store(b, i, &st);
+	}
+	return b;
+}
+
+
+void
+envelope_bank_destroy (EnvelopeBank *b)
+{
+	free(b);
+}
+
+
+void
+envelope_bank_trigger (EnvelopeBank *b, uint32_t lane)
+{
+	EnvelopeState st;
+	bank_load(b, lane, &st);
+	state_trigger(b->p, &st);
+	bank_store(b, lane, &st);
+}
+
+
+void
+envelope_bank_release (EnvelopeBank *b, uint32_t lane)
+{
+	EnvelopeState st;
+	bank_load(b, lane, &st);
+	state_release(b->p, &st);
+	bank_store(b, lane, &st);
+}
+
+
+// Stop a lane immediately, without a release
+void
+envelope_bank_reset (EnvelopeBank *b, uint32_t lane)
+{
+	EnvelopeState st;
+	state_init(&st);
+	bank_store(b, lane, &st);
+}
+
+
+int
+envelope_bank_run (EnvelopeBank *b, uint32_t lane, float *samples, uint32_t nsamples)
+{
+	EnvelopeState st;
+	int active;
+
+	bank_load(b, lane, &st);
+	active = state_run(b->p, &st, samples, nsamples);
+	bank_store(b, lane, &st);
+	return active;
+}
+
+
+// Render several lanes over the same span.  Each section is o = a + s*frame,
+// so one pass over the state arrays picks a and s per lane and moves the lane
+// along, then every lane is rendered by the same loop.  Lanes that reach the
+// end of a section within the span go through the scalar path instead.
+void
+envelope_bank_run_lanes (EnvelopeBank *b, const uint32_t *lanes, uint32_t nlanes,
+                         float *const *samples, uint32_t nsamples)
+{
+	const float mod = *b->p->mod;
+	const float sus = *b->p->sus;
+	uint32_t nrun = 0;
+	uint32_t i, f;
+
+	if (nsamples == 0 || nlanes == 0) {
+		return;
+	}
+
+	float    a[nlanes];
+	float    s[nlanes];
+	uint32_t run[nlanes];
+
+	for (i = 0; i < nlanes; ++i) {
+		const uint32_t l       = lanes[i];
+		const uint32_t frame   = b->frame[l];
+		const uint32_t nframes = b->nframes[l];
+		// SUS and OFF never end by themselves
+		uint32_t left = UINT32_MAX;
+		float    a0   = 0.0f;
+		float    s0   = 0.0f;
+
+		switch (b->q[l]) {
+		case ENV_HOLD:
+			a0 = 1.0f;
+			// Fall-through
+		case ENV_DEL:
+			left = nframes + 1 - frame;
+			break;
+		case ENV_ATT:
+			left = (frame + 1 >= nframes) ? 1 : nframes - frame;
+			s0   = 1.0f / nframes;
+			a0   = frame * s0;
+			break;
+		case ENV_DEC:
+			left = nframes + 1 - frame;
+			s0   = (1.0f / nframes)*(sus - 1.0f);
+			a0   = 1.0f + frame * s0;
+			break;
+		case ENV_SUS:
+			a0 = sus;
+			break;
+		case ENV_REL:
+			left = (frame + 1 >= nframes) ? 1 : nframes - frame;
+			s0   = -b->rel_base[l] / nframes;
+			a0   = b->rel_base[l] + frame * s0;
+			break;
+		}
+
+		if (left <= nsamples) {
+			envelope_bank_run(b, l, samples[i], nsamples);
+			continue;
+		}
+		if (left != UINT32_MAX) {
+			b->frame[l] = frame + nsamples;
+		}
+		b->last_sample[l] = a0 + s0 * (nsamples - 1);
+		a[nrun]   = a0;
+		s[nrun]   = s0;
+		run[nrun] = i;
+		++nrun;
+	}
+
+	for (i = 0; i < nrun; ++i) {
+		float *out = samples[run[i]];
+		for (f = 0; f < nsamples; ++f) {
+			out[f] = (a[i] + s[i] * f) * mod;
+		}
+	}
+}
\ No newline at end of file
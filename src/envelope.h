@@ -3,6 +3,18 @@
 
 #include <stdint.h>
 
+// STATES
+enum {
+	ENV_OFF,        // Off
+	ENV_DEL,        // Delay
+	ENV_ATT,        // Attack
+	ENV_HOLD,       // Hold
+	ENV_DEC,        // Decay
+	ENV_SUS,        // Sustain
+	ENV_REL         // Release
+};
+
+
 typedef struct envelope_state {
 	int q;                  // State
 	uint32_t frame;         // Frame of current state
@@ -30,6 +42,19 @@ typedef struct envelope {
 } Envelope;
 
 
+// A bank of envelopes sharing one set of parameters.  The state is kept as
+// structure-of-arrays with one lane per envelope.
+typedef struct envelope_bank {
+	EnvelopeParams *p;
+	uint32_t  nlanes;
+	int      *q;
+	uint32_t *frame;
+	uint32_t *nframes;
+	float    *rel_base;
+	float    *last_sample;
+} EnvelopeBank;
+
+
 Envelope *envelope_create (EnvelopeParams *p);
 
 void envelope_destroy (Envelope *e);
@@ -39,4 +64,18 @@ void envelope_release (Envelope *e);
 
 int envelope_run (Envelope *e, float *sample, uint32_t nsamples);
 
+EnvelopeBank *envelope_bank_create (EnvelopeParams *p, uint32_t nlanes);
+
+void envelope_bank_destroy (EnvelopeBank *b);
+
+void envelope_bank_trigger (EnvelopeBank *b, uint32_t lane);
+void envelope_bank_release (EnvelopeBank *b, uint32_t lane);
+void envelope_bank_reset (EnvelopeBank *b, uint32_t lane);
+
+int envelope_bank_run (EnvelopeBank *b, uint32_t lane, float *sample, uint32_t nsamples);
+
+// Run the given lanes over the same nsamples, lanes[i] into samples[i]
+void envelope_bank_run_lanes (EnvelopeBank *b, const uint32_t *lanes, uint32_t nlanes,
+                              float *const *samples, uint32_t nsamples);
+
 #endif // ENVELOPE_H__
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "lmms_lv2.h"
+#include "lmms_math.h"
 #include "uris.h"
 #include "envelope.h"
 #include "envelope_generator.h"
@@ -19,19 +20,35 @@ envgen_connect_port (LV2_Handle instance,
                      void      *data)
 {
 	EnvelopeGenerator *plugin = (EnvelopeGenerator *)instance;
+	uint32_t chidx;
+
+	// Handle the shared parameter ports
+	if (port < ENVGEN_GATE_IN) {
+		BEGIN_CONNECT_PORTS(port);
+		CONNECT_PORT(ENVGEN_DEL, params.del, float);
+		CONNECT_PORT(ENVGEN_ATT, params.att, float);
+		CONNECT_PORT(ENVGEN_HOLD, params.hold, float);
+		CONNECT_PORT(ENVGEN_DEC, params.dec, float);
+		CONNECT_PORT(ENVGEN_SUS, params.sus, float);
+		CONNECT_PORT(ENVGEN_REL, params.rel, float);
+		CONNECT_PORT(ENVGEN_MOD, params.mod, float);
+		END_CONNECT_PORTS();
+		return;
+	}
+
+	// Calculate channel index of channel-specific ports
+	chidx = (port - ENVGEN_GATE_IN) / ENVGEN_CHANNEL_PORTS;
+	port  = (port - ENVGEN_GATE_IN) % ENVGEN_CHANNEL_PORTS + ENVGEN_GATE_IN;
+	if (chidx >= plugin->nchannels) {
+		return;
+	}
 
+	// Now connect a channel-specific port
 	BEGIN_CONNECT_PORTS(port);
-	CONNECT_PORT(ENVGEN_DEL, params.del, float);
-	CONNECT_PORT(ENVGEN_ATT, params.att, float);
-	CONNECT_PORT(ENVGEN_HOLD, params.hold, float);
-	CONNECT_PORT(ENVGEN_DEC, params.dec, float);
-	CONNECT_PORT(ENVGEN_SUS, params.sus, float);
-	CONNECT_PORT(ENVGEN_REL, params.rel, float);
-	CONNECT_PORT(ENVGEN_MOD, params.mod, float);
-	CONNECT_PORT(ENVGEN_GATE_IN, gate_in_port, float);
-	CONNECT_PORT(ENVGEN_TRIGGER, trigger_port, float);
-	CONNECT_PORT(ENVGEN_GATE_OUT, gate_out_port, float);
-	CONNECT_PORT(ENVGEN_ENV_OUT, env_out_port, float);
+	CONNECT_PORT(ENVGEN_GATE_IN, ch[chidx].gate_in_port, float);
+	CONNECT_PORT(ENVGEN_TRIGGER, ch[chidx].trigger_port, float);
+	CONNECT_PORT(ENVGEN_GATE_OUT, ch[chidx].gate_out_port, float);
+	CONNECT_PORT(ENVGEN_ENV_OUT, ch[chidx].env_out_port, float);
 	END_CONNECT_PORTS();
 }
 
@@ -40,7 +57,7 @@ static void
 envgen_cleanup (LV2_Handle instance)
 {
 	EnvelopeGenerator *plugin = (EnvelopeGenerator *)instance;
-	envelope_destroy(plugin->env);
+	envelope_bank_destroy(plugin->env);
 	free(plugin);
 }
 
@@ -61,12 +78,25 @@ envgen_instantiate (const LV2_Descriptor      *descriptor,
 	plugin->srate = rate;
 	plugin->lasto = 0.0f;
 
+	// The poly variant only differs by its number of channel groups
+	plugin->nchannels = strcmp(descriptor->URI, ENVELOPE_GENERATOR_POLY_URI)
+	                    ? 1 : ENVGEN_POLY_CHANNELS;
+
+	// Gate and trigger are optional, hosts may never connect them
+	memset(plugin->ch, 0, sizeof(plugin->ch));
+
 	// TODO: Setting this param like this is a hack
 	plugin->params.time_base = rate * SECS_PER_ENV_SEGMENT;
 
-	plugin->env = envelope_create(&plugin->params);
+	plugin->env = envelope_bank_create(&plugin->params, plugin->nchannels);
+	if (!plugin->env) {
+		fprintf(stderr, "Could not allocate Envelope Generator envelopes.\n");
+		free(plugin);
+		return NULL;
+	}
 
 	memset(&plugin->uris, 0, sizeof(plugin->uris));
+	plugin->map = NULL;
 
 	/* Scan host features for URID map and map everything */
 	for (int i = 0; features[i]; ++i) {
@@ -85,33 +115,155 @@ envgen_instantiate (const LV2_Descriptor      *descriptor,
 	return (LV2_Handle)plugin;
 
 fail:
+	envelope_bank_destroy(plugin->env);
 	free(plugin);
 	return 0;
 }
 
 
 
+// Find the first frame in [pos, end) where the trigger input is high.
+// Scans in fixed-size chunks: the comparisons within a chunk are branch-free
+// so the compiler can vectorize them, we only branch once per chunk.
+static uint32_t
+envgen_scan_trigger (const float *trigger, uint32_t pos, uint32_t end)
+{
+	while (pos < end) {
+		const uint32_t n = q_min(ENVGEN_SCAN_CHUNK, end - pos);
+		int hit = 0;
+		for (uint32_t f = 0; f < n; ++f) {
+			hit |= trigger[pos+f] > 0.5f;
+		}
+		if (hit) {
+			while (trigger[pos] <= 0.5f) {
+				++pos;
+			}
+			return pos;
+		}
+		pos += n;
+	}
+	return end;
+}
+
+
+// Find the first frame in [pos, end) where the gate input falls.  pos must be
+// greater than zero, since the previous frame is compared.
+static uint32_t
+envgen_scan_release (const float *gate, uint32_t pos, uint32_t end)
+{
+	while (pos < end) {
+		const uint32_t n = q_min(ENVGEN_SCAN_CHUNK, end - pos);
+		int hit = 0;
+		for (uint32_t f = 0; f < n; ++f) {
+			hit |= (gate[pos+f] < 0.5f) & (gate[pos+f-1] >= 0.5f);
+		}
+		if (hit) {
+			while (!(gate[pos] < 0.5f && gate[pos-1] >= 0.5f)) {
+				++pos;
+			}
+			return pos;
+		}
+		pos += n;
+	}
+	return end;
+}
+
+
 static void
-envgen_run (LV2_Handle instance,
-            uint32_t   sample_count)
+envgen_gate_out (EnvelopeGeneratorChannel *ch, uint32_t sample_count)
 {
-	EnvelopeGenerator *eg = (EnvelopeGenerator *)instance;
+	for (uint32_t pos = 0; pos < sample_count; ++pos) {
+		ch->gate_out_port[pos] = ch->env_out_port[pos] > 0.0f;
+	}
+}
+
+
+// Render one channel, in spans between trigger and release edges.  Returns
+// false without rendering when the channel has no edges in this block, so
+// the caller can run all such channels together.
+static bool
+envgen_run_channel (EnvelopeBank             *env,
+                    uint32_t                  lane,
+                    EnvelopeGeneratorChannel *ch,
+                    uint32_t                  sample_count)
+{
+	const float *trigger = ch->trigger_port;
+	const float *gate    = ch->gate_in_port;
+	uint32_t pos, end, next_trig, next_rel;
+
+	// Unconnected inputs never trigger or release
+	next_trig = trigger ? envgen_scan_trigger(trigger, 0, sample_count)
+	                    : sample_count;
+	if (!gate || sample_count == 0) {
+		next_rel = sample_count;
+	} else if (gate[0] < 0.5f) {
+		// Releasing an already released envelope is harmless
+		next_rel = 0;
+	} else {
+		next_rel = envgen_scan_release(gate, 1, sample_count);
+	}
+
+	// Idle lanes stay idle until the next trigger
+	if (env->q[lane] == ENV_OFF && next_trig == sample_count) {
+		memset(ch->env_out_port, 0, sizeof(float) * sample_count);
+		memset(ch->gate_out_port, 0, sizeof(float) * sample_count);
+		env->last_sample[lane] = 0.0f;
+		return true;
+	}
+	if (next_trig == sample_count && next_rel == sample_count) {
+		return false;
+	}
+
+	for (pos = 0; pos < sample_count; pos = end) {
+		bool triggered = false;
 
-	int i;
-	for (i=0; i<sample_count; ++i) {
 		// Reset envelope
-		if (eg->trigger_port[i] > 0.5f) {
-			envelope_trigger(eg->env);
+		if (next_trig == pos) {
+			envelope_bank_trigger(env, lane);
+			next_trig = envgen_scan_trigger(trigger, pos+1, sample_count);
+			triggered = true;
+		}
+
+		// Release on a falling gate, or when triggered while the gate is low
+		if (next_rel == pos || (triggered && gate && gate[pos] < 0.5f)) {
+			envelope_bank_release(env, lane);
+		}
+		if (next_rel == pos) {
+			next_rel = envgen_scan_release(gate, pos+1, sample_count);
 		}
 
-		// release
-		if (eg->gate_in_port[i] < 0.5f) {
-			envelope_release(eg->env);
+		end = q_min(next_trig, next_rel);
+		envelope_bank_run(env, lane, &(ch->env_out_port[pos]), end - pos);
+	}
+
+	envgen_gate_out(ch, sample_count);
+	return true;
+}
+
+
+static void
+envgen_run (LV2_Handle instance,
+            uint32_t   sample_count)
+{
+	EnvelopeGenerator *eg = (EnvelopeGenerator *)instance;
+	uint32_t lanes[ENVGEN_POLY_CHANNELS];
+	float   *out[ENVGEN_POLY_CHANNELS];
+	uint32_t nlanes = 0;
+
+	for (uint32_t c = 0; c < eg->nchannels; ++c) {
+		if (!envgen_run_channel(eg->env, c, &eg->ch[c], sample_count)) {
+			lanes[nlanes] = c;
+			out[nlanes]   = eg->ch[c].env_out_port;
+			++nlanes;
 		}
+	}
 
-		// Stupid way FIXME: Run for the longest run before a trig/rel
-		envelope_run(eg->env, &(eg->env_out_port[i]), 1);
-		eg->gate_out_port[i] = eg->env_out_port[i] > 0.0f;
+	// Channels without edges run over the whole block together
+	if (nlanes > 0) {
+		envelope_bank_run_lanes(eg->env, lanes, nlanes, out, sample_count);
+	}
+	for (uint32_t i = 0; i < nlanes; ++i) {
+		envgen_gate_out(&eg->ch[lanes[i]], sample_count);
 	}
 }
 
@@ -169,3 +321,15 @@ const LV2_Descriptor envelope_generator_descriptor = {
 	envgen_extension_data
 };
 
+
+const LV2_Descriptor envelope_generator_poly_descriptor = {
+	ENVELOPE_GENERATOR_POLY_URI,
+	envgen_instantiate,
+	envgen_connect_port,
+	NULL, // activate,
+	envgen_run,
+	NULL, // deactivate,
+	envgen_cleanup,
+	envgen_extension_data
+};
+
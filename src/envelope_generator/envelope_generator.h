@@ -4,5 +4,6 @@
 #include "lv2/lv2plug.in/ns/lv2core/lv2.h"
 
 extern const LV2_Descriptor envelope_generator_descriptor;
+extern const LV2_Descriptor envelope_generator_poly_descriptor;
 
 #endif
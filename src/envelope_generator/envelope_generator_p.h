@@ -5,6 +5,10 @@
 #include "envelope.h"
 
 #define SECS_PER_ENV_SEGMENT (5.0f)
+// Frames compared at once while scanning the CV inputs for edges
+#define ENVGEN_SCAN_CHUNK (16)
+// Channel groups of the polyphonic variant
+#define ENVGEN_POLY_CHANNELS (8)
 
 // PORTS
 enum {
@@ -21,16 +25,26 @@ enum {
 	ENVGEN_ENV_OUT   = 10
 };
 
+// Ports per channel group, the poly variant repeats GATE_IN..ENV_OUT
+#define ENVGEN_CHANNEL_PORTS (ENVGEN_ENV_OUT - ENVGEN_GATE_IN + 1)
 
-typedef struct {
-	/* Features */
-	LV2_URID_Map *map;
 
-	/* Ports */
+// CV ports of one gate/trigger/output group
+typedef struct {
 	float *gate_in_port;
 	float *trigger_port;
 	float *gate_out_port;
 	float *env_out_port;
+} EnvelopeGeneratorChannel;
+
+
+typedef struct {
+	/* Features */
+	LV2_URID_Map *map;
+
+	/* Ports */
+	EnvelopeGeneratorChannel ch[ENVGEN_POLY_CHANNELS];
+	uint32_t nchannels;
 
 	/* Direct parameter ports */
 	EnvelopeParams params;
@@ -45,7 +59,8 @@ typedef struct {
 	double    srate;
 	float     lasto;
 
-	Envelope *env;
+	// One lane per channel, all sharing params
+	EnvelopeBank *env;
 
 } EnvelopeGenerator;
 
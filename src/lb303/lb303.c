@@ -44,6 +44,14 @@
 static uint32_t lb303_map_uri (LB303Synth *plugin, const char *uri);
 
 
+static inline bool
+lb303_is_note_on (LB303Synth *plugin, const LV2_Atom_Event *ev)
+{
+	const uint8_t *data = (const uint8_t *)(ev + 1);
+	return ev->body.type == plugin->uris.midi_event && (data[0] & 0xF0) == 0x90;
+}
+
+
 static void
 lb303_connect_port (LV2_Handle  instance,
                     uint32_t    port,
@@ -64,6 +72,9 @@ lb303_connect_port (LV2_Handle  instance,
 	CONNECT_PORT(LB303_DEAD, dead_port, float);
 	CONNECT_PORT(LB303_DIST, dist_port, float);
 	CONNECT_PORT(LB303_FILTER, filter_port, float);
+	CONNECT_PORT(LB303_EVENT_GRID, event_grid_port, float);
+	CONNECT_PORT(LB303_QUALITY, quality_port, float);
+	CONNECT_PORT(LB303_FREEWHEEL, freewheel_port, float);
 	END_CONNECT_PORTS();
 }
 
@@ -154,6 +165,31 @@ fail:
 }
 
 
+// Current VCO sample.  At high quality the saw's reset is smoothed with a
+// polynomial BLEP over the samples either side of it.
+static inline float
+lb303_vco_sample (LB303Synth *plugin)
+{
+	const float inc = plugin->vco_inc;
+	float t, x;
+
+	if (plugin->quality < LB303_QUALITY_HIGH || inc <= 0.0f) {
+		return plugin->vco_c;
+	}
+
+	// Position in the period, the reset is at 0/1
+	t = plugin->vco_c + 0.5f;
+	if (t < inc) {
+		x = t / inc;
+		return plugin->vco_c - 0.5f * (x + x - x * x - 1.0f);
+	} else if (t > 1.0f - inc) {
+		x = (t - 1.0f) / inc;
+		return plugin->vco_c - 0.5f * (x * x + x + x + 1.0f);
+	}
+	return plugin->vco_c;
+}
+
+
 static void
 lb303_run (LV2_Handle instance,
            uint32_t   sample_count)
@@ -165,12 +201,25 @@ lb303_run (LV2_Handle instance,
 	uint32_t    ev_frames;
 	uint32_t    f = plugin->frame;
 
+	// Frames events are quantized to, 1 for sample accurate
+	const uint32_t grid = t_limit((int)*plugin->event_grid_port, 1, LB303_MAX_EVENT_GRID);
+
+	// Offline renders (host freewheeling) always get the best quality
+	plugin->quality = (*plugin->freewheel_port > 0.5f) ? LB303_QUALITY_HIGH
+	                : t_limit((int)(*plugin->quality_port + 0.5f),
+	                          LB303_QUALITY_DRAFT, LB303_QUALITY_HIGH);
+
 	LV2_Atom_Event *ev = lv2_atom_sequence_begin(&plugin->event_port->body);
 
 	for (pos = 0; pos < sample_count;) {
 		// Check for next event
 		if (!lv2_atom_sequence_is_end(&plugin->event_port->body, plugin->event_port->atom.size, ev)) {
 			ev_frames = ev->time.frames;
+			// With an event grid, everything but note-ons is applied at the
+			// grid line before it (but not before the last event).
+			if (grid > 1 && !lb303_is_note_on(plugin, ev)) {
+				ev_frames = q_max(ev_frames - ev_frames % grid, pos);
+			}
 		} else {
 			ev = NULL;
 			ev_frames = sample_count;
@@ -210,7 +259,7 @@ lb303_run (LV2_Handle instance,
 			plugin->frame = f;
 
 			// Apply envelope 
-			output[pos] = plugin->vco_c * plugin->vca_a;
+			output[pos] = lb303_vco_sample(plugin) * plugin->vca_a;
 
 			// Filter
 			switch ((int)*plugin->filter_port) {
@@ -508,12 +557,20 @@ lb303_filter_3pole_run (LB303Synth *p, float *sampl)
 	float ay11 = p->vcf.ay1;
 	float ay31 = p->vcf.ay2;
 
-	p->vcf.lastin  = (*sampl) - tanh(p->vcf.kres * p->vcf.aout);
+	if (p->quality == LB303_QUALITY_DRAFT) {
+		p->vcf.lastin  = (*sampl) - fast_tanh(p->vcf.kres * p->vcf.aout);
+	} else {
+		p->vcf.lastin  = (*sampl) - tanh(p->vcf.kres * p->vcf.aout);
+	}
 	p->vcf.ay1     = p->vcf.kp1h * (p->vcf.lastin+ax1) - (p->vcf.kp * p->vcf.ay1);
 	p->vcf.ay2     = p->vcf.kp1h * (p->vcf.ay1 + ay11) - (p->vcf.kp * p->vcf.ay2);
 	p->vcf.aout    = p->vcf.kp1h * (p->vcf.ay2 + ay31) - (p->vcf.kp * p->vcf.aout);
 
-	*sampl = tanh(p->vcf.aout * p->vcf.value) * LB_24_VOL_ADJUST / (1.0 + (*p->dist_port));
+	if (p->quality == LB303_QUALITY_DRAFT) {
+		*sampl = fast_tanh(p->vcf.aout * p->vcf.value) * LB_24_VOL_ADJUST / (1.0 + (*p->dist_port));
+	} else {
+		*sampl = tanh(p->vcf.aout * p->vcf.value) * LB_24_VOL_ADJUST / (1.0 + (*p->dist_port));
+	}
 }
 
 
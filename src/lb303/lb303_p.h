@@ -32,7 +32,19 @@ enum {
 	LB303_ACCENT    = 8,
 	LB303_DEAD      = 9,
 	LB303_DIST      = 10,
-	LB303_FILTER    = 11
+	LB303_FILTER    = 11,
+	LB303_EVENT_GRID = 12,
+	LB303_QUALITY   = 13,
+	LB303_FREEWHEEL = 14
+};
+
+// Coarsest event grid, in frames
+#define LB303_MAX_EVENT_GRID 64
+
+enum {
+	LB303_QUALITY_DRAFT  = 0, // Approximated filter saturation
+	LB303_QUALITY_NORMAL = 1,
+	LB303_QUALITY_HIGH   = 2  // Band-limited VCO
 };
 
 enum {
@@ -90,6 +102,9 @@ typedef struct {
 	float *vcf_res_port;
 	float *vcf_mod_port;
 	float *vcf_dec_port;
+	float *event_grid_port;
+	float *quality_port;
+	float *freewheel_port;
 
 	/* URIs TODO: Global*/
 	struct {
@@ -103,6 +118,7 @@ typedef struct {
 	uint8_t  midi_note;
 
 	bool  dead;
+	int   quality;          // LB303_QUALITY_* of the current run
 
 	float vco_inc,          // Sample increment for the frequency. Creates Sawtooth.
 	      vco_c;            // Raw oscillator sample [-0.5,0.5]
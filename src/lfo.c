@@ -1,7 +1,9 @@
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 #include "lfo.h"
+#include "lmms_lv2.h"
 #include "lmms_math.h"
 #include "oscillator.h"
 
@@ -14,25 +16,6 @@ enum {
 };
 
 
-sample_t
-lfo_get_osc_sample (float wave_shape, float sample)
-{
-	switch ((int)(wave_shape)) {
-	case LFO_WAVE_SINE:
-		return osc_sample_sine(sample);
-	case LFO_WAVE_TRIANGLE:
-		return osc_sample_triangle(fraction(sample));
-	case LFO_WAVE_SAW:
-		return osc_sample_saw(fraction(sample));
-	case LFO_WAVE_SQUARE:
-		return osc_sample_square(fraction(sample));
-	default:
-		fprintf(stderr, "Oscillator: Invalid wave shape\n");
-		return 0;
-	}
-}
-
-
 // Advance LFO state to next non-zero-length section
 static void
 advance_state (LfoParams *p, LfoState *st)
@@ -64,6 +47,157 @@ advance_state (LfoParams *p, LfoState *st)
 }
 
 
+static void
+state_init (LfoState *st)
+{
+	st->q       = LFO_OFF;
+	st->frame   = 0;
+	st->nframes = 0;
+	st->phase   = 0.0f;
+}
+
+
+static void
+state_trigger (LfoParams *p, LfoState *st)
+{
+	st->q     = LFO_OFF;
+	st->phase = 0.0f;
+	advance_state(p, st);
+}
+
+
+// Fill buf with the LFO oscillator, returns the advanced phase
+static float
+fill_osc (int wave_shape, float phase, float inc, float *buf, uint32_t len)
+{
+	uint32_t f;
+
+	// Switch once per run rather than per sample
+	switch (wave_shape) {
+	case LFO_WAVE_SINE:
+		for (f = 0; f < len; ++f, phase += inc) {
+			buf[f] = osc_sample_sine(phase);
+		}
+		break;
+	case LFO_WAVE_TRIANGLE:
+		for (f = 0; f < len; ++f, phase += inc) {
+			buf[f] = osc_sample_triangle(fraction(phase));
+		}
+		break;
+	case LFO_WAVE_SAW:
+		for (f = 0; f < len; ++f, phase += inc) {
+			buf[f] = osc_sample_saw(fraction(phase));
+		}
+		break;
+	case LFO_WAVE_SQUARE:
+		for (f = 0; f < len; ++f, phase += inc) {
+			buf[f] = osc_sample_square(fraction(phase));
+		}
+		break;
+	default:
+		fprintf(stderr, "Oscillator: Invalid wave shape\n");
+		for (f = 0; f < len; ++f, phase += inc) {
+			buf[f] = 0.0f;
+		}
+		break;
+	}
+	return phase;
+}
+
+
+// Render at most MOD_BLOCK_LEN frames
+static void
+state_run_block (LfoParams *p, LfoState *st, float *samples, uint32_t nsamples)
+{
+	// Total LFO amount
+	const float amt = *p->mod * 0.5f;
+	// TODO: See if we can yank the divide out (into timebase?)
+	const float inc = 1.0f/(p->time_base * (*p->spd));
+	// Operation (modulate vs mix)
+	const bool modulate = *p->op > 0.5;
+
+	float lvl[MOD_BLOCK_LEN];
+	float osc[MOD_BLOCK_LEN];
+	uint32_t i = 0;
+	uint32_t f;
+
+	st->phase = fill_osc(*p->shape, st->phase, inc, osc, nsamples);
+
+	// Render the LFO-env one state section at a time
+	while (i < nsamples) {
+		uint32_t len = nsamples - i;
+		uint32_t left;
+
+		switch (st->q) {
+		case LFO_DEL:
+			// Delay lasts nframes+1 frames
+			left = st->nframes + 1 - st->frame;
+			len  = q_min(len, left);
+			for (f = 0; f < len; ++f) {
+				lvl[i+f] = 0.0f;
+			}
+			st->frame += len;
+			if (len == left) {
+				advance_state(p, st);
+			}
+			break;
+
+		case LFO_ATT:
+			left = (st->frame + 1 >= st->nframes) ? 1 : st->nframes - st->frame;
+			len  = q_min(len, left);
+			for (f = 0; f < len; ++f) {
+				lvl[i+f] = ((float)(st->frame + f)) / (st->nframes);
+			}
+			st->frame += len;
+			if (st->frame >= st->nframes) {
+				advance_state(p, st);
+			}
+			break;
+
+		case LFO_SUS:
+			for (f = 0; f < len; ++f) {
+				lvl[i+f] = 1.0f; // Sustain Level;
+			}
+			break;
+
+		case LFO_OFF:
+		default:
+			for (f = 0; f < len; ++f) {
+				lvl[i+f] = 0.0f;
+			}
+			break;
+		}
+		i += len;
+	}
+
+	// Modulate with LFO-env with LFO-osc
+	if (modulate) {
+		for (f = 0; f < nsamples; ++f) {
+			samples[f] *= 0.5f + lvl[f] * osc[f] * amt;
+		}
+	} else {
+		for (f = 0; f < nsamples; ++f) {
+			samples[f] += lvl[f] * osc[f] * amt;
+		}
+	}
+}
+
+
+static int
+state_run (LfoParams *p, LfoState *st, float *samples, uint32_t nsamples)
+{
+	uint32_t pos, len;
+
+	for (pos = 0; pos < nsamples; pos += len) {
+		len = q_min(nsamples - pos, MOD_BLOCK_LEN);
+		state_run_block(p, st, samples + pos, len);
+	}
+
+	// Return 1 if envelope is still active
+	return st->q != LFO_OFF;
+}
+
+
 Lfo *
 lfo_create (LfoParams *p)
 {
@@ -73,10 +207,7 @@ lfo_create (LfoParams *p)
 		l->p = p;
 
 		// Internal state
-		l->st.q           = LFO_OFF;
-		l->st.frame       = 0;
-		l->st.nframes     = 0;
-		l->st.phase       = 0.0f;
+		state_init(&l->st);
 		return l;
 	}
 	return NULL;
@@ -93,67 +224,221 @@ lfo_destroy (Lfo *lfo)
 void
 lfo_trigger (Lfo *lfo)
 {
-	lfo->st.q = LFO_OFF;
-	lfo->st.phase = 0.0f;
-	advance_state(lfo->p, &lfo->st);
+	state_trigger(lfo->p, &lfo->st);
 }
 
 
 int
 lfo_run (Lfo *lfo, float *samples, uint32_t nsamples)
 {
-	int i;
-	float o;
+	return state_run(lfo->p, &lfo->st, samples, nsamples);
+}
 
-	for (i=0; i<nsamples; ++i) {
-		// Stupid way
-		switch (lfo->st.q) {
-		case LFO_DEL:
-			// Process
-			o = 0.0f;
-			// State change
-			lfo->st.frame++;
-			if (lfo->st.frame > lfo->st.nframes) {
-				advance_state(lfo->p, &lfo->st);
+
+//// LFO banks
+
+
+// Gather a lane into a scalar state so it can be run in registers
+static inline void
+bank_load (LfoBank *b, uint32_t lane, LfoState *st)
+{
+	st->q       = b->q[lane];
+	st->frame   = b->frame[lane];
+	st->nframes = b->nframes[lane];
+	st->phase   = b->phase[lane];
+}
+
+
+static inline void
+bank_store (LfoBank *b, uint32_t lane, const LfoState *st)
+{
+	b->q[lane]       = st->q;
+	b->frame[lane]   = st->frame;
+	b->nframes[lane] = st->nframes;
+	b->phase[lane]   = st->phase;
+}
+
+
+LfoBank *
+lfo_bank_create (LfoParams *p, uint32_t nlanes)
+{
+	// One allocation for the bank and all of its lanes
+	LfoBank *b = malloc(sizeof(LfoBank) + nlanes *
+	                    (sizeof(int) + sizeof(uint32_t) * 2 + sizeof(float)));
+	LfoState st;
+	uint32_t i;
+
+	if (!b) {
+		return NULL;
+	}
+
+	b->p       = p;
+	b->nlanes  = nlanes;
+	b->q       = (int *)(b + 1);
+	b->frame   = (uint32_t *)(b->q + nlanes);
+	b->nframes = b->frame + nlanes;
+	b->phase   = (float *)(b->nframes + nlanes);
+
+	state_init(&st);
+	for (i = 0; i < nlanes; ++i) {
+		bank_store(b, i, &st);
+	}
+	return b;
+}
+
+
+void
+lfo_bank_destroy (LfoBank *b)
+{
+	free(b);
+}
+
+
+void
+lfo_bank_trigger (LfoBank *b, uint32_t lane)
+{
+	LfoState st;
+	bank_load(b, lane, &st);
+	state_trigger(b->p, &st);
+	bank_store(b, lane, &st);
+}
+
+
+int
+lfo_bank_run (LfoBank *b, uint32_t lane, float *samples, uint32_t nsamples)
+{
+	LfoState st;
+	int active;
+
+	bank_load(b, lane, &st);
+	active = state_run(b->p, &st, samples, nsamples);
+	bank_store(b, lane, &st);
+	return active;
+}
+
+
+static inline float
+lfo_shape (int wave_shape, float phase)
+{
+	switch (wave_shape) {
+	case LFO_WAVE_SINE:
+		return osc_sample_sine(phase);
+	case LFO_WAVE_TRIANGLE:
+		return osc_sample_triangle(fraction(phase));
+	case LFO_WAVE_SAW:
+		return osc_sample_saw(fraction(phase));
+	case LFO_WAVE_SQUARE:
+		return osc_sample_square(fraction(phase));
+	default:
+		return 0.0f;
+	}
+}
+
+
+// Render lanes whose LFO-env level is lvl = a + s*frame over the whole span.
+// Inlined with a constant wave_shape, so the shape is picked once per run
+// instead of once per lane.
+static inline void
+run_lanes_shape (LfoBank *b, int wave_shape, const uint32_t *lanes,
+                 const uint32_t *run, const float *a, const float *s,
+                 uint32_t nrun, float *const *samples, uint32_t nsamples)
+{
+	const LfoParams *p   = b->p;
+	const float amt      = *p->mod * 0.5f;
+	const float inc      = 1.0f/(p->time_base * (*p->spd));
+	const bool  modulate = *p->op > 0.5;
+	uint32_t i, f;
+
+	for (i = 0; i < nrun; ++i) {
+		const uint32_t l = lanes[run[i]];
+		float *out  = samples[run[i]];
+		float phase = b->phase[l];
+
+		if (modulate) {
+			for (f = 0; f < nsamples; ++f, phase += inc) {
+				out[f] *= 0.5f + (a[i] + s[i] * f) * lfo_shape(wave_shape, phase) * amt;
 			}
-			break;
+		} else {
+			for (f = 0; f < nsamples; ++f, phase += inc) {
+				out[f] += (a[i] + s[i] * f) * lfo_shape(wave_shape, phase) * amt;
+			}
+		}
+		b->phase[l] = phase;
+	}
+}
+
+
+// Run several lanes over the same span.  One pass over the state arrays gives
+// each lane's LFO-env level as a + s*frame and advances it, then the shape is
+// evaluated for all lanes at once.  Lanes that reach the end of a section
+// within the span go through the scalar path instead.
+void
+lfo_bank_run_lanes (LfoBank *b, const uint32_t *lanes, uint32_t nlanes,
+                    float *const *samples, uint32_t nsamples)
+{
+	uint32_t nrun = 0;
+	uint32_t i;
+
+	if (nsamples == 0 || nlanes == 0) {
+		return;
+	}
+
+	float    a[nlanes];
+	float    s[nlanes];
+	uint32_t run[nlanes];
 
+	for (i = 0; i < nlanes; ++i) {
+		const uint32_t l       = lanes[i];
+		const uint32_t frame   = b->frame[l];
+		const uint32_t nframes = b->nframes[l];
+		// SUS and OFF never end by themselves
+		uint32_t left = UINT32_MAX;
+		float    a0   = 0.0f;
+		float    s0   = 0.0f;
+
+		switch (b->q[l]) {
+		case LFO_DEL:
+			left = nframes + 1 - frame;
+			break;
 		case LFO_ATT:
-			// Process
-			o = ((float)lfo->st.frame) / (lfo->st.nframes);
-			// State
-			lfo->st.frame++;
-			if (lfo->st.frame >= lfo->st.nframes) {
-				advance_state(lfo->p, &lfo->st);
-			}
+			left = (frame + 1 >= nframes) ? 1 : nframes - frame;
+			s0   = 1.0f / nframes;
+			a0   = frame * s0;
 			break;
-
 		case LFO_SUS:
-			o = 1.0f; // Sustain Level;
-			break;
-
-		case LFO_OFF:
-		default:
-			o = 0.0f;
+			a0 = 1.0f;
 			break;
 		}
 
-		// Modulate with LFO-env with LFO-osc
-		o *= lfo_get_osc_sample (*lfo->p->shape, lfo->st.phase);
-		// Total LFO amount
-		o *= *lfo->p->mod * 0.5f;
-		// Update phase
-		// TODO: See if we can yank the divide out (into timebase?)
-		lfo->st.phase += 1.0f/(lfo->p->time_base * (*lfo->p->spd));
-
-		// Operation (modulate vs mix)
-		if (*lfo->p->op > 0.5) {
-			samples[i] *= (0.5f + o);
-		} else {
-			samples[i] += o;
+		if (left <= nsamples) {
+			lfo_bank_run(b, l, samples[i], nsamples);
+			continue;
 		}
+		if (left != UINT32_MAX) {
+			b->frame[l] = frame + nsamples;
+		}
+		a[nrun]   = a0;
+		s[nrun]   = s0;
+		run[nrun] = i;
+		++nrun;
 	}
 
-	// Return 1 if envelope is still active
-	return lfo->st.q != LFO_OFF;
-}
+	switch ((int)*b->p->shape) {
+	case LFO_WAVE_SINE:
+		run_lanes_shape(b, LFO_WAVE_SINE, lanes, run, a, s, nrun, samples, nsamples);
+		break;
+	case LFO_WAVE_TRIANGLE:
+		run_lanes_shape(b, LFO_WAVE_TRIANGLE, lanes, run, a, s, nrun, samples, nsamples);
+		break;
+	case LFO_WAVE_SAW:
+		run_lanes_shape(b, LFO_WAVE_SAW, lanes, run, a, s, nrun, samples, nsamples);
+		break;
+	case LFO_WAVE_SQUARE:
+		run_lanes_shape(b, LFO_WAVE_SQUARE, lanes, run, a, s, nrun, samples, nsamples);
+		break;
+	default:
+		fprintf(stderr, "Oscillator: Invalid wave shape\n");
+		run_lanes_shape(b, -1, lanes, run, a, s, nrun, samples, nsamples);
+		break;
+	}
+}
\ No newline at end of file
@@ -35,6 +35,18 @@ typedef struct {
 	LfoState   st;
 } Lfo;
 
+
+// A bank of LFOs sharing one set of parameters.  The state is kept as
+// structure-of-arrays with one lane per LFO.
+typedef struct {
+	LfoParams *p;
+	uint32_t   nlanes;
+	int       *q;
+	uint32_t  *frame;
+	uint32_t  *nframes;
+	float     *phase;
+} LfoBank;
+
 Lfo *lfo_create (LfoParams *p);
 
 void lfo_destroy (Lfo *lfo);
@@ -42,4 +54,15 @@ void lfo_destroy (Lfo *lfo);
 void lfo_trigger (Lfo *lfo);
 int lfo_run (Lfo *lfo, float* samples, uint32_t nsamples);
 
+LfoBank *lfo_bank_create (LfoParams *p, uint32_t nlanes);
+
+void lfo_bank_destroy (LfoBank *b);
+
+void lfo_bank_trigger (LfoBank *b, uint32_t lane);
+int lfo_bank_run (LfoBank *b, uint32_t lane, float *samples, uint32_t nsamples);
+
+// Run the given lanes over the same nsamples, lanes[i] into samples[i]
+void lfo_bank_run_lanes (LfoBank *b, const uint32_t *lanes, uint32_t nlanes,
+                         float *const *samples, uint32_t nsamples);
+
 #endif // LFO_H__
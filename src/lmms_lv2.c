@@ -21,6 +21,8 @@ lv2_descriptor (uint32_t index)
 		return &envelope_generator_descriptor;
 	case 3:
 		return &sidemu_descriptor;
+	case 4:
+		return &envelope_generator_poly_descriptor;
 	default:
 		return NULL;
 	}
@@ -3,11 +3,15 @@
 
 // Pollute our namespace with some "Standard" Headers
 
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "config.h"
 
 #include "lv2/lv2plug.in/ns/lv2core/lv2.h"
 #include "lv2/lv2plug.in/ns/ext/state/state.h"
 #include "lv2/lv2plug.in/ns/ext/atom/util.h"
+#include "lv2/lv2plug.in/ns/ext/options/options.h"
 #include "lv2/lv2plug.in/ns/ext/urid/urid.h"
 
 // Typedefs and Utility functions
@@ -25,4 +29,35 @@
 typedef float       sample_t;  // standard sample type
 typedef uint16_t    fpp_t;     // frames per period (0-16384)
 
+#define CACHE_LINE_SIZE 64
+#define ALIGNED(n) __attribute__((aligned(n)))
+
+// Max frames rendered per modulation block.  This is the tile instruments
+// render voices in, sized so a voice's intermediate buffers stay in L1.
+#define MOD_BLOCK_LEN TILE_SIZE
+
+// Allocate size bytes aligned to align (a power of two).  The pointer
+// returned by malloc is stashed just below the aligned block.
+static inline void *
+aligned_malloc (size_t size, size_t align)
+{
+	void *p = malloc(size + align - 1 + sizeof(void *));
+	uintptr_t a;
+
+	if (!p) {
+		return NULL;
+	}
+	a = ((uintptr_t)p + sizeof(void *) + align - 1) & ~(uintptr_t)(align - 1);
+	((void **)a)[-1] = p;
+	return (void *)a;
+}
+
+static inline void
+aligned_free (void *p)
+{
+	if (p) {
+		free(((void **)p)[-1]);
+	}
+}
+
 #endif //LMMS_LV2_H__
@@ -8,6 +8,7 @@
 */
 
 #include <math.h>
+#include <stdint.h>
 
 #ifndef PRG_MATH_H__
 #define PRG_MATH_H__
@@ -118,12 +119,26 @@ static inline float exp_knob_val (float val) {
 	return fabsf(val) * val;
 }
 
+static inline float db_to_amp (float db) {
+	return powf(10.0f, db * 0.05f);
+}
+
+// Pade approximation of tanh, within 2% and saturating at +/-3
+static inline float fast_tanh (float x) {
+	if (x > 3.0f) {
+		return 1.0f;
+	} else if (x < -3.0f) {
+		return -1.0f;
+	}
+	return x * (27.0f + x * x) / (27.0f + 9.0f * x * x);
+}
+
 #define FAST_RAND_MAX 32767
+// Callers keep their own state, so threads never share one
 static inline int
-fast_rand () {
-	static unsigned long next = 1;
-	next = next * 1103515245 + 12345;
-	return( (unsigned)( next / 65536 ) % 32768 );
+fast_rand (uint32_t *next) {
+	*next = *next * 1103515245 + 12345;
+	return( (unsigned)( *next / 65536 ) % 32768 );
 }
 
 #define safe_fmodf(x) fmodf((x) + 4.0f, 1.0f)
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+
+#include "modulation.h"
+
+
+ModulationEngine *
+modulation_create (EnvelopeParams *env_params,
+                   LfoParams      *lfo_params,
+                   uint32_t        nvoices)
+{
+	ModulationEngine *m = calloc(1, sizeof(ModulationEngine));
+	int t;
+
+	if (!m) {
+		return NULL;
+	}
+
+	m->nvoices = nvoices;
+	m->buf     = calloc(nvoices * MOD_NTARGETS * MOD_BLOCK_LEN, sizeof(float));
+	if (!m->buf) {
+		goto fail;
+	}
+
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		m->env[t] = envelope_bank_create(&env_params[t], nvoices);
+		m->lfo[t] = lfo_bank_create(&lfo_params[t], nvoices);
+		if (!m->env[t] || !m->lfo[t]) {
+			goto fail;
+		}
+	}
+	return m;
+
+fail:
+	modulation_destroy(m);
+	return NULL;
+}
+
+
+void
+modulation_destroy (ModulationEngine *m)
+{
+	int t;
+
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		if (m->env[t]) {
+			envelope_bank_destroy(m->env[t]);
+		}
+		if (m->lfo[t]) {
+			lfo_bank_destroy(m->lfo[t]);
+		}
+	}
+	free(m->buf);
+	free(m);
+}
+
+
+void
+modulation_trigger (ModulationEngine *m, uint32_t voice)
+{
+	int t;
+
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		envelope_bank_trigger(m->env[t], voice);
+	}
+
+	// COMPATABILITY: We trigger a per-voice LFO while LMMS has one LFO
+	// per-instrument.
+	// TODO: Add option to toggle between both modes.
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		lfo_bank_trigger(m->lfo[t], voice);
+	}
+}
+
+
+void
+modulation_release (ModulationEngine *m, uint32_t voice)
+{
+	int t;
+
+	// LFOs keep running through the release
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		envelope_bank_release(m->env[t], voice);
+	}
+}
+
+
+// Stop all envelopes of a voice immediately, so it can be stolen
+void
+modulation_kill (ModulationEngine *m, uint32_t voice)
+{
+	int t;
+
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		envelope_bank_reset(m->env[t], voice);
+	}
+}
+
+
+// Render nframes (<= MOD_BLOCK_LEN) of every target for the given voices.
+void
+modulation_run (ModulationEngine *m, const uint32_t *voices,
+                uint32_t nvoices, uint32_t nframes)
+{
+	uint32_t i;
+	int t;
+
+	if (nvoices == 0) {
+		return;
+	}
+
+	float *out[nvoices];
+
+	// Run one bank over all voices at a time, so the shared parameters stay
+	// hot and each lane's state is only touched once per block.
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		for (i = 0; i < nvoices; ++i) {
+			out[i] = modulation_buffer(m, voices[i], t);
+		}
+		envelope_bank_run_lanes(m->env[t], voices, nvoices, out, nframes);
+	}
+	for (t = 0; t < MOD_NTARGETS; ++t) {
+		for (i = 0; i < nvoices; ++i) {
+			out[i] = modulation_buffer(m, voices[i], t);
+		}
+		lfo_bank_run_lanes(m->lfo[t], voices, nvoices, out, nframes);
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef MODULATION_H__
+#define MODULATION_H__
+
+#include <stdint.h>
+
+#include "envelope.h"
+#include "lfo.h"
+#include "lmms_lv2.h"
+
+// Modulation targets
+enum {
+	MOD_VOL,
+	MOD_CUT,
+	MOD_RES,
+	MOD_NTARGETS
+};
+
+
+// Envelopes and LFOs of all voices.  Each target is driven by an envelope
+// bank and an LFO bank with one lane per voice, so the modulators of all
+// voices are advanced together.
+typedef struct modulation_engine {
+	uint32_t      nvoices;
+	EnvelopeBank *env[MOD_NTARGETS];
+	LfoBank      *lfo[MOD_NTARGETS];
+	float        *buf;     // [voice][target][MOD_BLOCK_LEN]
+} ModulationEngine;
+
+
+ModulationEngine *modulation_create (EnvelopeParams *env_params,
+                                     LfoParams      *lfo_params,
+                                     uint32_t        nvoices);
+
+void modulation_destroy (ModulationEngine *m);
+
+void modulation_trigger (ModulationEngine *m, uint32_t voice);
+void modulation_release (ModulationEngine *m, uint32_t voice);
+void modulation_kill (ModulationEngine *m, uint32_t voice);
+
+void modulation_run (ModulationEngine *m, const uint32_t *voices,
+                     uint32_t nvoices, uint32_t nframes);
+
+
+// Modulation buffer of a voice/target as rendered by the last run
+static inline float *
+modulation_buffer (ModulationEngine *m, uint32_t voice, int target)
+{
+	return m->buf + (voice * MOD_NTARGETS + target) * MOD_BLOCK_LEN;
+}
+
+
+// Voice is sounding as long as its volume envelope is running
+static inline int
+modulation_active (const ModulationEngine *m, uint32_t voice)
+{
+	return m->env[MOD_VOL]->q[voice] != ENV_OFF;
+}
+
+
+static inline int
+modulation_releasing (const ModulationEngine *m, uint32_t voice)
+{
+	return m->env[MOD_VOL]->q[voice] == ENV_REL;
+}
+
+
+// Envelope output of a voice/target at the end of the last run, before
+// the modulation amount and LFO are applied
+static inline float
+modulation_env_level (const ModulationEngine *m, uint32_t voice, int target)
+{
+	return m->env[target]->last_sample[voice];
+}
+
+#endif // MODULATION_H__
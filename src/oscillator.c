@@ -24,9 +24,12 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "oscillator.h"
 
+float decim_kernel_2x[OSC_DECIM_TAPS(2)];
+float decim_kernel_4x[OSC_DECIM_TAPS(4)];
 float blep_table[OSC_BLEP_SIZE];
 float blamp_table[OSC_BLEP_SIZE];
 float sine_table[OSC_WAVE_LEN];
@@ -47,11 +50,12 @@ Oscillator *
 osc_create ()
 {
 	Oscillator *o = (Oscillator *)malloc(sizeof(Oscillator));
-	osc_reset(o, 0.f, 0.f, 440.f, 1.f, NULL, 0.f, 0.f);
 	if (!o) {
 		fprintf(stderr, "Could not allocate Oscillator.\n");
 		return NULL;
 	}
+	osc_reset(o, 0.f, 0.f, 440.f, 1.f, NULL, 0.f, 0.f);
+	osc_seed_noise(o, 1);
 
 	return o;
 }
@@ -70,17 +74,27 @@ osc_reset (Oscillator *o, float wave_shape, float modulation_algo,
 	o->modulation_algo = modulation_algo;
 	o->freq = freq / sample_rate;
 	o->volume = volume;
+	o->volume_target = volume;
+	o->volume_step   = 0.0f;
+	o->volume_ramp   = 0;
 	o->ext_phase_offset = phase_offset;
 	o->sub_osc = sub_osc;
 	o->phase_offset = phase_offset;
 	o->phase = phase_offset;
 	o->sample_rate = sample_rate;
+	o->inc_limit   = OSC_AA_MAX_FREQ / sample_rate;
 
 	// Singleton construction of BLEP/BLAMP tables
 	if (!blep_table[0] && !blamp_table[0]) {
 		blep_init(blep_table, blamp_table, OSC_BLEP_SIZE);
 	}
 
+	// Singleton construction of the decimation filters
+	if (!decim_kernel_2x[0]) {
+		decim_init(decim_kernel_2x, OSC_DECIM_TAPS(2), 2);
+		decim_init(decim_kernel_4x, OSC_DECIM_TAPS(4), 4);
+	}
+
 	// Single construction of Sine table
 	if (!sine_table[0]) {
 		sine_init(sine_table, OSC_WAVE_LEN);
@@ -104,6 +118,13 @@ osc_destroy (Oscillator *o)
 }
 
 
+void
+osc_seed_noise (Oscillator *o, uint32_t seed)
+{
+	o->noise = seed;
+}
+
+
 void
 osc_print (Oscillator *o)
 {
@@ -130,77 +151,119 @@ osc_recalc_phase (Oscillator *o)
 }
 
 
+// Phase increment of a frame.  bend is NULL while the pitch-bend is steady,
+// the increment is then the same for every frame.
+static inline float
+osc_inc (const Oscillator *o, const sample_t *bend, float steady_inc, fpp_t frame)
+{
+	return bend ? o->freq * bend[frame] : steady_inc;
+}
+
+
+// Progress the volume ramp through len frames, as rendering them would
+static inline void
+osc_volume_skip (Oscillator *o, fpp_t len)
+{
+	if (o->volume_ramp > len) {
+		o->volume      += o->volume_step * len;
+		o->volume_ramp -= len;
+	} else if (o->volume_ramp) {
+		o->volume      = o->volume_target;
+		o->volume_ramp = 0;
+	}
+}
+
+
 //// Non-antialiased update functions
 
 
 // if we have no sub-osc, we can't do any modulation... just get our samples
 static void
-osc_update_no_sub (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_update_no_sub (Oscillator *o, sample_t *buff,
+                   const sample_t *bend, float bend_ratio, fpp_t len)
 {
+	const float steady_inc = o->freq * bend_ratio;
+
 	osc_recalc_phase(o);
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
 		buff[frame] = osc_get_sample(o, o->phase) * o->volume;
-		o->phase += o->freq * bend[frame];
+		osc_volume_tick(o);
+		o->phase += osc_inc(o, bend, steady_inc, frame);
 	}
 }
 
 
 // do PM by using sub-osc as modulator
 static void
-osc_update_pm (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_update_pm (Oscillator *o, sample_t *buff,
+               const sample_t *bend, float bend_ratio, fpp_t len)
 {
-	osc_update(o->sub_osc, buff, bend, len);
+	const float steady_inc = o->freq * bend_ratio;
+
+	osc_update(o->sub_osc, buff, bend, bend_ratio, len);
 	osc_recalc_phase(o);
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
 		buff[frame] = osc_get_sample(o, o->phase + buff[frame]) * o->volume;
-		o->phase += o->freq * bend[frame];
+		osc_volume_tick(o);
+		o->phase += osc_inc(o, bend, steady_inc, frame);
 	}
 }
 
 
 // do fm by using sub-osc as modulator
 static void
-osc_update_fm (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_update_fm (Oscillator *o, sample_t *buff,
+               const sample_t *bend, float bend_ratio, fpp_t len)
 {
+	const float steady_inc = o->freq * bend_ratio;
 	const float srate_correction = 44100.0f / o->sample_rate;
 
-	osc_update(o->sub_osc, buff, bend, len);
+	osc_update(o->sub_osc, buff, bend, bend_ratio, len);
 	osc_recalc_phase(o);
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
 		o->phase += buff[frame] * srate_correction;
 		buff[frame] = osc_get_sample(o, o->phase) * o->volume;
-		o->phase += o->freq * bend[frame];
+		osc_volume_tick(o);
+		o->phase += osc_inc(o, bend, steady_inc, frame);
 	}
 }
 
 
 // do AM by using sub-osc as modulator
 static void
-osc_update_am (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_update_am (Oscillator *o, sample_t *buff,
+               const sample_t *bend, float bend_ratio, fpp_t len)
 {
-	osc_update(o->sub_osc, buff, bend, len);
+	const float steady_inc = o->freq * bend_ratio;
+
+	osc_update(o->sub_osc, buff, bend, bend_ratio, len);
 	osc_recalc_phase(o);
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
 		buff[frame] *= osc_get_sample(o, o->phase) * o->volume;
-		o->phase += o->freq * bend[frame];
+		osc_volume_tick(o);
+		o->phase += osc_inc(o, bend, steady_inc, frame);
 	}
 }
 
 
 // do mixing by using sub-osc as mix-sample
 static void
-osc_update_mix (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_update_mix (Oscillator *o, sample_t *buff,
+                const sample_t *bend, float bend_ratio, fpp_t len)
 {
-	osc_update(o->sub_osc, buff, bend, len);
+	const float steady_inc = o->freq * bend_ratio;
+
+	osc_update(o->sub_osc, buff, bend, bend_ratio, len);
 	osc_recalc_phase(o);
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
 		buff[frame] += osc_get_sample(o, o->phase) * o->volume;
-		o->phase += o->freq * bend[frame];
+		osc_volume_tick(o);
+		o->phase += osc_inc(o, bend, steady_inc, frame);
 	}
 }
 
@@ -216,26 +279,33 @@ osc_sync_ok (Oscillator *o, float osc_coeff)
 }
 
 
+// Returns the sub-osc's phase increment per frame, at factor times the rate
+// when oversampling
 static float
-osc_sync_init (Oscillator *o, sample_t *buff, sample_t *bend, const fpp_t len)
+osc_sync_init (Oscillator *o, sample_t *buff,
+               const sample_t *bend, float bend_ratio, const fpp_t len,
+               int factor)
 {
 	if (o->sub_osc != NULL) {
-		osc_update(o->sub_osc, buff, bend, len);
+		osc_update(o->sub_osc, buff, bend, bend_ratio, len);
 	}
 	osc_recalc_phase(o);
 
 	// FIXME: Do we need to multiply by bend somehow?
-	return o->freq;
+	return o->freq / factor;
 }
 
 
 // sync with sub-osc (every time sub-osc starts new period, we also start new
 // period)
 static void
-osc_update_sync (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_update_sync (Oscillator *o, sample_t *buff,
+                 const sample_t *bend, float bend_ratio, fpp_t len)
 {
+	const float steady_inc = o->freq * bend_ratio;
+
 	// FIXME: sub_osc_coeff is not correct.  Fix for bend!
-	const float sub_osc_coeff = osc_sync_init(o->sub_osc, buff, bend, len);
+	const float sub_osc_coeff = osc_sync_init(o->sub_osc, buff, bend, bend_ratio, len, 1);
 
 	osc_recalc_phase(o);
 
@@ -244,13 +314,15 @@ osc_update_sync (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
 			o->phase = o->phase_offset;
 		}
 		buff[frame] = osc_get_sample(o, o->phase) * o->volume;
-		o->phase += o->freq * bend[frame];
+		osc_volume_tick(o);
+		o->phase += osc_inc(o, bend, steady_inc, frame);
 	}
 }
 
 
 void
-osc_update (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_update (Oscillator *o, sample_t *buff,
+            const sample_t *bend, float bend_ratio, fpp_t len)
 {
 	if (o->freq >= o->sample_rate / 2) {
 		return;
@@ -258,29 +330,73 @@ osc_update (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
 	if (o->sub_osc != NULL) {
 		switch ((int)o->modulation_algo) {
 		case OSC_MOD_PM:
-			osc_update_pm(o, buff, bend, len);
+			osc_update_pm(o, buff, bend, bend_ratio, len);
 			break;
 		case OSC_MOD_AM:
-			osc_update_am(o, buff, bend, len);
+			osc_update_am(o, buff, bend, bend_ratio, len);
 			break;
 		case OSC_MOD_MIX:
-			osc_update_mix(o, buff, bend, len);
+			osc_update_mix(o, buff, bend, bend_ratio, len);
 			break;
 		case OSC_MOD_SYNC:
-			osc_update_sync(o, buff, bend, len);
+			osc_update_sync(o, buff, bend, bend_ratio, len);
 			break;
 		case OSC_MOD_FM:
-			osc_update_fm(o, buff, bend, len);
+			osc_update_fm(o, buff, bend, bend_ratio, len);
 			break;
 		default:
 			fprintf(stderr, "Oscillator: Invalid modulation algorithm\n");
 		}
 	} else {
-		osc_update_no_sub(o, buff, bend, len);
+		osc_update_no_sub(o, buff, bend, bend_ratio, len);
 	}
 }
 
 
+// Advance the oscillator chain through len frames without rendering them,
+// leaving the phases where osc_update() would.  Sync is replayed, FM is not,
+// as in osc_aa_skip().
+void
+osc_skip (Oscillator *o, const sample_t *bend, float bend_ratio, fpp_t len)
+{
+	const float steady_inc = o->freq * bend_ratio;
+
+	if (o->freq >= o->sample_rate / 2) {
+		return;
+	}
+
+	if (o->sub_osc != NULL && (int)o->modulation_algo == OSC_MOD_SYNC) {
+		// As osc_update_sync(): the sub-osc only advances its phase
+		Oscillator  *sub = o->sub_osc;
+		const float  sub_osc_coeff = sub->freq;
+
+		if (sub->sub_osc != NULL) {
+			osc_skip(sub->sub_osc, bend, bend_ratio, len);
+		}
+		osc_recalc_phase(sub);
+		osc_recalc_phase(o);
+
+		for (fpp_t frame = 0; frame < len; ++frame) {
+			if (osc_sync_ok(sub, sub_osc_coeff)) {
+				o->phase = o->phase_offset;
+			}
+			o->phase += osc_inc(o, bend, steady_inc, frame);
+		}
+	} else {
+		if (o->sub_osc != NULL) {
+			osc_skip(o->sub_osc, bend, bend_ratio, len);
+		}
+		osc_recalc_phase(o);
+
+		for (fpp_t frame = 0; frame < len; ++frame) {
+			o->phase += osc_inc(o, bend, steady_inc, frame);
+		}
+	}
+
+	osc_volume_skip(o, len);
+}
+
+
 sample_t
 osc_get_sample (Oscillator *o, float sample)
 {
@@ -298,7 +414,7 @@ osc_get_sample (Oscillator *o, float sample)
 	case OSC_WAVE_EXPONENTIAL:
 		return osc_sample_exp(fraction(sample));
 	case OSC_WAVE_NOISE:
-		return osc_sample_noise(sample);
+		return osc_sample_noise(&o->noise);
 	default:
 		fprintf(stderr, "Oscillator: Invalid wave shape\n");
 		return 0;
@@ -311,136 +427,321 @@ osc_get_sample (Oscillator *o, float sample)
 
 // if we have no sub-osc, we can't do any modulation... just get our samples
 static void
-osc_aa_update_no_sub (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_aa_update_no_sub (Oscillator *o, sample_t *buff,
+                      const sample_t *bend, float bend_ratio, fpp_t len)
 {
+	const float steady_inc = o->freq * bend_ratio;
+
 	o->phase_mod = 0.0f;
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
-		buff[frame] = osc_get_aa_sample(o, o->freq * bend[frame], -1.0f) * o->volume;
+		buff[frame] = osc_get_aa_sample(o, osc_inc(o, bend, steady_inc, frame), -1.0f) * o->volume;
+		osc_volume_tick(o);
 	}
 }
 
 
 // do PM by using sub-osc as modulator
 static void
-osc_aa_update_pm (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_aa_update_pm (Oscillator *o, sample_t *buff,
+                  const sample_t *bend, float bend_ratio, fpp_t len)
 {
+	const float steady_inc = o->freq * bend_ratio;
 	float osc_coeff;
 
-	osc_aa_update(o->sub_osc, buff, bend, len);
-
 	for (fpp_t frame = 0; frame < len; ++frame) {
 		//TODO: Huh? what is the 2.0f?
-		osc_coeff    = o->freq * bend[frame];
+		osc_coeff    = osc_inc(o, bend, steady_inc, frame);
 		o->phase_mod = buff[frame] * osc_coeff / 2.0f;
 		buff[frame]  = osc_get_aa_sample(o, osc_coeff, -1.0f) * o->volume;
+		osc_volume_tick(o);
 	}
 }
 
 
 // do FM by using sub-osc as modulator
 static void
-osc_aa_update_fm (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_aa_update_fm (Oscillator *o, sample_t *buff,
+                  const sample_t *bend, float bend_ratio, fpp_t len)
 {
+	const float steady_inc = o->freq * bend_ratio;
 	float osc_coeff;
 
-	osc_aa_update(o->sub_osc, buff, bend, len);
-
 	for (fpp_t frame = 0; frame < len; ++frame) {
 		//TODO: Huh? what is the 2.0f?
-		osc_coeff    = o->freq * bend[frame];
+		osc_coeff    = osc_inc(o, bend, steady_inc, frame);
 		o->phase_mod = buff[frame] * osc_coeff * 2.0f;
 		buff[frame]  = osc_get_aa_sample(o, osc_coeff, -1.0f) * o->volume;
+		osc_volume_tick(o);
 	}
 }
 
 
 // do AM by using sub-osc as modulator
 static void
-osc_aa_update_am (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_aa_update_am (Oscillator *o, sample_t *buff,
+                  const sample_t *bend, float bend_ratio, fpp_t len)
 {
-	osc_aa_update(o->sub_osc, buff, bend, len);
+	const float steady_inc = o->freq * bend_ratio;
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
-		buff[frame] *= osc_get_aa_sample(o, o->freq * bend[frame], -1.0f) * o->volume;
+		buff[frame] *= osc_get_aa_sample(o, osc_inc(o, bend, steady_inc, frame), -1.0f) * o->volume;
+		osc_volume_tick(o);
 	}
 }
 
 
 // do mix by using sub-osc as mix-sample
 static void
-osc_aa_update_mix (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_aa_update_mix (Oscillator *o, sample_t *buff,
+                   const sample_t *bend, float bend_ratio, fpp_t len)
 {
-	osc_aa_update(o->sub_osc, buff, bend, len);
+	const float steady_inc = o->freq * bend_ratio;
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
-		buff[frame] += osc_get_aa_sample(o, o->freq * bend[frame], -1.0f) * o->volume;
+		buff[frame] += osc_get_aa_sample(o, osc_inc(o, bend, steady_inc, frame), -1.0f) * o->volume;
+		osc_volume_tick(o);
 	}
 }
 
 
 // sync with sub-osc (every time sub-osc starts new period, we also start new
-// period)
+// period).  factor is the oversampling factor of the frames in buff.
 static void
-osc_aa_update_sync (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+osc_aa_update_sync (Oscillator *o, sample_t *buff,
+                    const sample_t *bend, float bend_ratio, fpp_t len,
+                    int factor)
 {
+	const float steady_inc = o->freq * bend_ratio;
+
 	// FIXME: sub_osc_coeff is not correct.  Fix for bend!
-	const float sub_osc_coeff = osc_sync_init(o->sub_osc, buff, bend, len);
+	const float sub_osc_coeff = osc_sync_init(o->sub_osc, buff, bend, bend_ratio, len,
+	                                          factor);
 	float osc_coeff;
 
 	o->phase_mod = 0.0f;
 
 	for (fpp_t frame = 0; frame < len; ++frame) {
-		osc_coeff = o->freq * bend[frame];
+		osc_coeff = osc_inc(o, bend, steady_inc, frame);
 		if (osc_sync_ok(o->sub_osc, sub_osc_coeff)) {
 			buff[frame] = osc_get_aa_sample(o, osc_coeff, o->phase_offset) * o->volume;
 		} else {
 			buff[frame] = osc_get_aa_sample(o, osc_coeff, -1.0f) * o->volume;
 		}
+		osc_volume_tick(o);
 	}
 }
 
 
-void
-osc_aa_update (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len)
+//// Antialiased chain evaluation
+//
+// The per-stage functions above expect the sub-osc output in buff already.
+// osc_aa_update() walks down the chain once and runs the stages from the
+// last sub-osc up, so a whole tile goes through each stage in turn while
+// buff stays in cache.
+
+
+// Render one stage of the chain over the output of the stage below
+static void
+osc_aa_update_stage (Oscillator *o, sample_t *buff,
+                     const sample_t *bend, float bend_ratio, fpp_t len,
+                     int factor)
 {
-	// FIXME: Seems like this check is basically repeated in the sample code
-	// (inc_limit)
-	if (o->freq >= o->sample_rate / 2) {
-		return;
-	}
 	if (o->sub_osc != NULL) {
 		switch ((int)o->modulation_algo) {
 		case OSC_MOD_PM:
-			osc_aa_update_pm(o, buff, bend, len);
+			osc_aa_update_pm(o, buff, bend, bend_ratio, len);
 			break;
 		case OSC_MOD_AM:
-			osc_aa_update_am(o, buff, bend, len);
+			osc_aa_update_am(o, buff, bend, bend_ratio, len);
 			break;
 		case OSC_MOD_MIX:
-			osc_aa_update_mix(o, buff, bend, len);
+			osc_aa_update_mix(o, buff, bend, bend_ratio, len);
 			break;
 		case OSC_MOD_SYNC:
-			osc_aa_update_sync(o, buff, bend, len);
+			osc_aa_update_sync(o, buff, bend, bend_ratio, len, factor);
 			break;
 		case OSC_MOD_FM:
-			osc_aa_update_fm(o, buff, bend, len);
+			osc_aa_update_fm(o, buff, bend, bend_ratio, len);
 			break;
 		default:
 			fprintf(stderr, "Oscillator: Invalid modulation algorithm\n");
 		}
 	} else {
-		osc_aa_update_no_sub(o, buff, bend, len);
+		osc_aa_update_no_sub(o, buff, bend, bend_ratio, len);
 	}
 }
 
 
+// Render the chain with bend and bend_ratio already scaled to factor times
+// the rate
+static void
+osc_aa_update_chain (Oscillator *o, sample_t *buff,
+                     const sample_t *bend, float bend_ratio, fpp_t len,
+                     int factor)
+{
+	Oscillator *chain[OSC_MAX_CHAIN];
+	int n = 0;
+
+	// Collect the stages that get rendered.  An oscillator above Nyquist
+	// is silent and so is everything below it; sync only follows its
+	// sub-osc's phase, osc_aa_update_sync() advances that itself.
+	// FIXME: Seems like this check is basically repeated in the sample code
+	// (inc_limit)
+	while (o != NULL && o->freq < o->sample_rate / 2 && n < OSC_MAX_CHAIN) {
+		const int mod = (int)o->modulation_algo;
+
+		// Clamp to the same pitch whatever the rate
+		o->inc_limit = OSC_AA_MAX_FREQ / (o->sample_rate * factor);
+		chain[n++] = o;
+		if (mod != OSC_MOD_PM && mod != OSC_MOD_AM && mod != OSC_MOD_MIX &&
+		    mod != OSC_MOD_FM) {
+			break;
+		}
+		o = o->sub_osc;
+	}
+
+	// Modulators first
+	while (n > 0) {
+		osc_aa_update_stage(chain[--n], buff, bend, bend_ratio, len, factor);
+	}
+}
+
+
+void
+osc_aa_update (Oscillator *o, sample_t *buff,
+               const sample_t *bend, float bend_ratio, fpp_t len)
+{
+	osc_aa_update_chain(o, buff, bend, bend_ratio, len, 1);
+}
+
+
+void
+osc_aa_update_os (Oscillator *o, OscDecimator *d, sample_t *buff,
+                  sample_t *work, const sample_t *bend, float bend_ratio,
+                  fpp_t len, int factor)
+{
+	const int    ntaps  = OSC_DECIM_TAPS(factor);
+	const float *kernel = (factor == 2) ? decim_kernel_2x : decim_kernel_4x;
+	const int    oslen  = len * factor;
+	sample_t    *os     = work + ntaps - 1;
+	sample_t    *osbend = NULL;
+
+	// Every frame's phase increment is split over factor frames
+	if (bend) {
+		osbend = os + oslen;
+		for (fpp_t frame = 0; frame < len; ++frame) {
+			for (int k = 0; k < factor; ++k) {
+				osbend[frame * factor + k] = bend[frame] / factor;
+			}
+		}
+	}
+
+	memcpy(work, d->hist, (ntaps - 1) * sizeof(sample_t));
+	osc_aa_update_chain(o, os, osbend, bend_ratio / factor, oslen, factor);
+
+	// Polyphase decimation: the filter only runs for the frames kept.
+	// The kernel is symmetric, so each output is a plain dot product
+	// the compiler can vectorize.
+	for (fpp_t frame = 0; frame < len; ++frame) {
+		const sample_t *x = work + frame * factor + factor - 1;
+		float acc = 0.0f;
+
+		for (int t = 0; t < ntaps; ++t) {
+			acc += kernel[t] * x[t];
+		}
+		buff[frame] = acc;
+	}
+
+	memcpy(d->hist, work + oslen, (ntaps - 1) * sizeof(sample_t));
+}
+
+
+void
+osc_decimator_reset (OscDecimator *d)
+{
+	memset(d->hist, 0, sizeof(d->hist));
+}
+
+
+// Advance the oscillator chain through len frames without rendering them,
+// for spans where the output would be discarded anyway.  Only the free
+// running phase is advanced: PM/FM and sync are not replayed, which is
+// inaudible since sync re-aligns on the next sub-osc period.
+void
+osc_aa_skip (Oscillator *o, const sample_t *bend, float bend_ratio, fpp_t len)
+{
+	// Same limit as the osc_get_aa_sample_* functions, at the base rate
+	const float inc_limit  = OSC_AA_MAX_FREQ / o->sample_rate;
+	const float steady_inc = o->freq * bend_ratio;
+	float adv = 0.0f;
+	int i;
+
+	if (o->freq >= o->sample_rate / 2) {
+		return;
+	}
+	if (o->sub_osc != NULL) {
+		osc_aa_skip(o->sub_osc, bend, bend_ratio, len);
+	}
+
+	// Sum of the increments osc_get_aa_sample() would have applied
+	for (fpp_t frame = 0; frame < len; ++frame) {
+		const float inc = osc_inc(o, bend, steady_inc, frame);
+		adv += (inc > inc_limit) ? inc_limit : inc;
+	}
+	o->phase_mod = 0.0f;
+	o->phase     = fraction(o->phase + adv);
+
+	// Volume ramp progresses as if rendered
+	osc_volume_skip(o, len);
+
+	// Pending BLEP corrections have played out
+	for (i = 0; i < OSC_NBLEPS; ++i) {
+		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
+			o->bleps[i].ptr = (o->bleps[i].ptr + len < 8) ? o->bleps[i].ptr + len : 8;
+		}
+	}
+}
+
+
+// Queue a BLEP (typ 0) or BLAMP (typ 1) correction of amplitude vol,
+// starting phs samples into the table.  Pipelines are reused round-robin.
+static inline void
+osc_blep_add (Oscillator *o, float vol, float phs, int typ)
+{
+	o->bleps[o->blep_idx].ptr = 0;  // reset table-pointer to activate it
+	o->bleps[o->blep_idx].vol = vol;
+	o->bleps[o->blep_idx].phs = phs;
+	o->bleps[o->blep_idx].typ = typ;
+	o->blep_idx = (o->blep_idx+1) % OSC_NBLEPS;
+}
+
+
+// Add the active BLEP pipelines to this sample's value, advancing them
+static inline float
+osc_blep_apply (Oscillator *o, float value)
+{
+	for (int i = 0; i < OSC_NBLEPS; ++i) {
+		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
+			const int offset = ( o->bleps[i].ptr + o->bleps[i].phs ) * OSC_BLEP_LEN;
+			if (o->bleps[i].typ) {
+				value += o->bleps[i].vol * blamp_table[ offset % OSC_BLEP_SIZE ];
+			} else {
+				value += o->bleps[i].vol * blep_table[ offset % OSC_BLEP_SIZE ];
+			}
+			o->bleps[i].ptr++;
+		}
+	}
+	return value;
+}
+
+
 sample_t
 osc_get_aa_sample_sine (Oscillator *o, float increment, float sync_offset)
 {
 	// limit increment to C9 (higher does not make any musical sense and just
 	// causes us a lot of trouble to correct this...)
-	float inc_limit = 8372.018089619f / o->sample_rate;
+	const float inc_limit = o->inc_limit;
 	float inc = (increment > inc_limit) ? inc_limit : increment;
 
 	// initialize current result with 0.0
@@ -449,8 +750,6 @@ osc_get_aa_sample_sine (Oscillator *o, float increment, float sync_offset)
 	float corr_amp   = 0.0f;
 	float corr_phs   = 0.0f;
 
-	int i;
-
 	// update phase
 	if (sync_offset < 0.0f) {
 		// Normal case, just increment phase
@@ -473,27 +772,11 @@ osc_get_aa_sample_sine (Oscillator *o, float increment, float sync_offset)
 
 
 	if (fabsf(corr_amp) > 0.00001f) { // need to correct this samples?
-		// Round-robin assignment of BLEP pipelines
-		o->bleps[o->blep_idx].ptr = 0;  // reset table-pointer to activate it
-		o->bleps[o->blep_idx].vol = corr_amp;
-		o->bleps[o->blep_idx].phs = corr_phs;
-		o->bleps[o->blep_idx].typ = 0;  // NOTE: This was missing in the original
-		o->blep_idx = (o->blep_idx+1) % OSC_NBLEPS;
-	}
-
-	// now go through all pipelines, check if active and process if so...
-	for (i = 0; i < OSC_NBLEPS; ++i) {
-		// FIXME: When is ptr < 0?
-		// TODO: Could start at blep_idx and search until we find an expired one
-		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
-			const int offset = ( o->bleps[i].ptr + o->bleps[i].phs ) * OSC_BLEP_LEN;
-			value += o->bleps[i].vol * blep_table[ offset % OSC_BLEP_SIZE ];
-			o->bleps[i].ptr++;
-		}
+		osc_blep_add(o, corr_amp, corr_phs, 0);
 	}
 
 	// puuhh... finished here... ;-)
-	return value;
+	return osc_blep_apply(o, value);
 }
 
 
@@ -502,7 +785,7 @@ osc_get_aa_sample_triangle (Oscillator *o, float increment, float sync_offset)
 {
 	// limit increment to C9 (higher does not make any musical sense and just
 	// causes us a lot of trouble to correct this...)
-	const float inc_limit = 8372.018089619f / o->sample_rate;
+	const float inc_limit = o->inc_limit;
 	const float inc = ( increment > inc_limit )? inc_limit:increment;
 
 	// initialize current result with 0.0
@@ -512,8 +795,6 @@ osc_get_aa_sample_triangle (Oscillator *o, float increment, float sync_offset)
 	float corr_phs   = 0.0f;
 	int   corr_typ   = 1;
 
-	int i;
-
 	// update phase
 	if (sync_offset < 0.0f) {
 		o->last_phase = o->phase;
@@ -547,51 +828,28 @@ osc_get_aa_sample_triangle (Oscillator *o, float increment, float sync_offset)
 	}
 
 	if (fabsf(corr_amp) > 0.00001f) { // need to correct this samples?
-		// Round-robin assignment of BLEP pipelines
-		o->bleps[o->blep_idx].ptr = 0;  // reset table-pointer to activate it
-		o->bleps[o->blep_idx].vol = corr_amp;
-		o->bleps[o->blep_idx].phs = corr_phs;
-		o->bleps[o->blep_idx].typ = corr_typ;
-		o->blep_idx = (o->blep_idx+1) % OSC_NBLEPS;
-	}
-
-	// now go through all pipelines, check if active and process if so...
-	for (i = 0; i < OSC_NBLEPS; ++i) {
-		// FIXME: When is ptr < 0?
-		// TODO: Could start at blep_idx and search until we find an expired one
-		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
-			const int offset = ( o->bleps[i].ptr + o->bleps[i].phs ) * OSC_BLEP_LEN;
-			// FIXME: EASY to remove this if
-			if (o->bleps[i].typ) {
-				value += o->bleps[i].vol * blamp_table[ offset % OSC_BLEP_SIZE ];
-			} else {
-				value += o->bleps[i].vol * blep_table[ offset % OSC_BLEP_SIZE ];
-			}
-			o->bleps[i].ptr++;
-		}
+		osc_blep_add(o, corr_amp, corr_phs, corr_typ);
 	}
 
 	// puuhh... finished here... ;-)
-	return value;
+	return osc_blep_apply(o, value);
 }
 
 
-// FIXME: increment can be deduced from Oscillator o.
-sample_t
-osc_get_aa_sample_saw (Oscillator *o, float increment, float sync_offset)
+// Shared core of the saw-derived waves.  A square is the difference of two
+// saws half a period apart, so every one of these waves is a ramp with at
+// most two steps: wrap_amp where the phase wraps around and edge_amp where
+// it passes edge (a pulse width for square).  The core advances the phase,
+// queues a BLEP per step and returns the corrected sample of shape.
+static inline sample_t
+osc_aa_saw_core (Oscillator *o, float increment, float sync_offset,
+                 sample_t (*shape)(float), float wrap_amp,
+                 float edge, float edge_amp)
 {
 	// limit increment to C9 (higher does not make any musical sense and just
 	// causes us a lot of trouble to correct this...)
-	float inc_limit = 8372.018089619f / o->sample_rate;
-	float inc = (increment > inc_limit) ? inc_limit : increment;
-
-	// initialize current result with 0.0
-	float value      = 0.0f;
-	float last_value = 0.0f;
-	float corr_amp   = 0.0f;
-	float corr_phs   = 0.0f;
-
-	int i;
+	const float inc_limit = o->inc_limit;
+	const float inc = (increment > inc_limit) ? inc_limit : increment;
 
 	// update phase
 	if (sync_offset < 0.0f) {
@@ -601,148 +859,63 @@ osc_get_aa_sample_saw (Oscillator *o, float increment, float sync_offset)
 
 		// TODO: Would be nice to remove this conditional somehow
 		if (o->phase >= 1.0f) {
-			// sawtooth just fell down cliff
+			// Wrapped forwards
 			o->phase = safe_fmodf(o->phase);
-			corr_phs = o->phase / (inc + o->phase_mod);
-			corr_amp = 2.0f;
-		} else if (o->phase <  0.0f) {
-			// sawtooth just went up cliff 
+			if (wrap_amp != 0.0f) {
+				osc_blep_add(o, wrap_amp, o->phase / (inc + o->phase_mod), 0);
+			}
+		} else if (o->phase < 0.0f) {
+			// Wrapped backwards (phase modulation)
 			o->phase = safe_fmodf(o->phase);
-			corr_phs = (1.0f - o->phase)/(inc - o->phase_mod);
-			corr_amp = -2.0f;
+			if (wrap_amp != 0.0f) {
+				osc_blep_add(o, -wrap_amp, (1.0f - o->phase)/(inc - o->phase_mod), 0);
+			}
 		}
 
-		value = osc_sample_saw(o->phase);
+		// TODO: what about phase < edge && last_phase >= edge (reverse direction)?
+		if (edge_amp != 0.0f && o->phase > edge && o->last_phase <= edge) {
+			osc_blep_add(o, edge_amp, (o->phase - edge) / inc, 0);
+		}
 	} else {
-		// Syncing,
+		// Syncing, the step is wherever the wave happens to be
+		float last_value;
+
 		o->last_phase = o->phase + inc*(1.0f - sync_offset);
 		o->phase      = sync_offset;
 
-		last_value = osc_sample_saw(o->last_phase);
-		value      = osc_sample_saw(o->phase);
-		// Get new values for correction.
-		corr_phs   = o->phase / inc;
-		corr_amp   = last_value - value;
-		// corr_typ   = false; (Default behavior)
-	}
-
-
-	if (fabsf(corr_amp) > 0.00001f) { // need to correct this samples?
-		// Round-robin assignment of BLEP pipelines
-		o->bleps[o->blep_idx].ptr = 0;  // reset table-pointer to activate it
-		o->bleps[o->blep_idx].vol = corr_amp;
-		o->bleps[o->blep_idx].phs = corr_phs;
-		o->bleps[o->blep_idx].typ = 0;  // NOTE: This was missing in the original
-		o->blep_idx = (o->blep_idx+1) % OSC_NBLEPS;
-	}
-
-	// now go through all pipelines, check if active and process if so...
-	for (i = 0; i < OSC_NBLEPS; ++i) {
-		// FIXME: When is ptr < 0?
-		// TODO: Could start at blep_idx and search until we find an expired one
-		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
-			const int offset = ( o->bleps[i].ptr + o->bleps[i].phs ) * OSC_BLEP_LEN;
-			value += o->bleps[i].vol * blep_table[ offset % OSC_BLEP_SIZE ];
-			o->bleps[i].ptr++;
+		last_value = shape(o->last_phase);
+		if (fabsf(last_value - shape(o->phase)) > 0.00001f) {
+			osc_blep_add(o, last_value - shape(o->phase), o->phase / inc, 0);
 		}
 	}
 
-	// puuhh... finished here... ;-)
-	return value;
+	return osc_blep_apply(o, shape(o->phase));
 }
 
 
-// TODO: constify parameters
+// FIXME: increment can be deduced from Oscillator o.
 sample_t
-osc_get_aa_sample_square (Oscillator *o, float increment, float sync_offset)
+osc_get_aa_sample_saw (Oscillator *o, float increment, float sync_offset)
 {
-	// limit increment to C9 (higher does not make any musical sense and just
-	// causes us a lot of trouble to correct this...)
-	const float inc_limit = 8372.018089619f / o->sample_rate;
-	const float inc = ( increment > inc_limit )? inc_limit:increment;
-
-	// initialize current result with 0.0
-	float value      = 0.0f;
-	float last_value = 0.0f;
-	float corr_amp   = 0.0f;
-	float corr_phs   = 0.0f;
-
-	int i;
-
-	// update phase
-	if (sync_offset < 0.0f) {
-		o->last_phase = o->phase;
-		o->phase      = o->phase + inc + o->phase_mod;
-
-		if (o->phase >= 1.0f) {
-			// Rising edge
-			o->phase = safe_fmodf(o->phase);
-			corr_phs = o->phase / (inc + o->phase_mod);
-			corr_amp = -2.0f;
-		} else if (o->phase < 0.0f) {
-			// Falling edge
-			o->phase = safe_fmodf(o->phase);
-			corr_phs = (1.0f - o->phase)/(inc - o->phase_mod);
-			corr_amp = 2.0f;
-		}
-
-		// Middle
-		// TODO: what about phase < 0.5 && last_phase >= 0.5 (reverse direction)? 
-		if (o->phase > 0.5f && o->last_phase <= 0.5f) {
-			corr_phs = (o->phase - 0.5f) / inc;
-			corr_amp = 2.0f;
-		}
-
-		value = osc_sample_square(o->phase);
-	} else {
-		o->last_phase = o->phase;
-		o->phase      = sync_offset;
-
-		last_value = osc_sample_square(o->last_phase);
-		value      = osc_sample_square(o->phase);
-		// New values for correction
-		corr_phs   = o->phase / inc;
-		corr_amp   = last_value - value;
-	}
+	// Falls down the cliff when wrapping
+	return osc_aa_saw_core(o, increment, sync_offset, osc_sample_saw,
+	                       2.0f, 0.0f, 0.0f);
+}
 
-	if (fabsf(corr_amp) > 0.00001f) { // need to correct this samples?
-		o->bleps[o->blep_idx].ptr = 0;  // reset table-pointer to activate it
-		o->bleps[o->blep_idx].vol = corr_amp;
-		o->bleps[o->blep_idx].phs = corr_phs;
-		o->bleps[o->blep_idx].typ = 0;  // NOTE: This was missing in the original
-	}
 
-	// now go through all pipelines, check if active and process if so...
-	for (i = 0; i < OSC_NBLEPS; ++i) {
-		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
-			const int offset = ( o->bleps[i].ptr + o->bleps[i].phs ) * OSC_BLEP_LEN;
-			value += o->bleps[i].vol * blep_table[ offset % OSC_BLEP_SIZE ];
-			o->bleps[i].ptr++;
-		}
-	}
-
-	// puuhh... finished here... ;-)
-	return value;
+sample_t
+osc_get_aa_sample_square (Oscillator *o, float increment, float sync_offset)
+{
+	// Rising edge at the wrap, falling edge half way
+	return osc_aa_saw_core(o, increment, sync_offset, osc_sample_square,
+	                       -2.0f, 0.5f, 2.0f);
 }
 
 
 sample_t
 osc_get_aa_sample_moog_saw (Oscillator *o, float increment, float sync_offset)
 {
-	// limit increment to C9 (higher does not make any musical sense and just
-	// causes us a lot of trouble to correct this...)
-	float inc_limit = 8372.018089619f / o->sample_rate;
-	float inc = ( increment > inc_limit )? inc_limit:increment;
-
-	// initialize current result with 0.0
-	float value      = 0.0f;
-	float last_value = 0.0f;
-	float corr_amp   = 0.0f;
-	float corr_phs   = 0.0f;
-
-	int i;
-
-	/* 
+	/*
 	 * NOTE: Stefan's original code shifted the wave by half a phase.  This
 	 * places the discontinuity at 0.0 and 1.0.  This algorithm didn't work
 	 * for me immediately, so I am using a standard phase offset, but
@@ -751,58 +924,9 @@ osc_get_aa_sample_moog_saw (Oscillator *o, float increment, float sync_offset)
 	 * However, Now I wonder if we need to check at 0.0 and 1.0 and do the
 	 * same code from triangle wave...
 	 */
-
-	// update phase
-	if (sync_offset < 0.0f) {
-		// Normal case, just increment phase
-		o->last_phase = o->phase;
-		o->phase      = safe_fmodf(o->phase + inc + o->phase_mod);
-
-		// Middle (Falling edge)
-		// TODO: what about phase < 0.5 && last_phase >= 0.5 (reverse direction)? 
-		if (o->phase > 0.5f && o->last_phase <= 0.5f) {
-			corr_phs = (o->phase - 0.5f) / inc;
-			corr_amp = 1.0f;
-		}
-
-		value = osc_sample_moog_saw(o->phase);
-	} else {
-		// Syncing, 
-		o->last_phase = o->phase + inc*(1.0f - sync_offset);
-		o->phase      = sync_offset;
-
-		// Stefan Original:
-		last_value = osc_sample_moog_saw(o->last_phase);
-		value      = osc_sample_moog_saw(o->phase);
-		
-		// Get new values for correction.
-		corr_phs   = o->phase / inc;
-		corr_amp   = last_value - value;
-		// corr_typ   = false; (Default behavior)
-	}
-
-	if (fabsf(corr_amp) > 0.00001f) { // need to correct this samples?
-		// Round-robin assignment of BLEP pipelines
-		o->bleps[o->blep_idx].ptr = 0;  // reset table-pointer to activate it
-		o->bleps[o->blep_idx].vol = corr_amp;
-		o->bleps[o->blep_idx].phs = corr_phs;
-		o->bleps[o->blep_idx].typ = 0;  // NOTE: This was missing in the original
-		o->blep_idx = (o->blep_idx+1) % OSC_NBLEPS;
-	}
-
-	// now go through all pipelines, check if active and process if so...
-	for (i = 0; i < OSC_NBLEPS; ++i) {
-		// FIXME: When is ptr < 0?
-		// TODO: Could start at blep_idx and search until we find an expired one
-		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
-			const int offset = ( o->bleps[i].ptr + o->bleps[i].phs ) * OSC_BLEP_LEN;
-			value += o->bleps[i].vol * blep_table[ offset % OSC_BLEP_SIZE ];
-			o->bleps[i].ptr++;
-		}
-	}
-
-	// puuhh... finished here... ;-)
-	return value;
+	// Continuous at the wrap, falling edge half way
+	return osc_aa_saw_core(o, increment, sync_offset, osc_sample_moog_saw,
+	                       0.0f, 0.5f, 1.0f);
 }
 
 
@@ -811,7 +935,7 @@ osc_get_aa_sample_exp (Oscillator *o, float increment, float sync_offset)
 {
 	// limit increment to C9 (higher does not make any musical sense and just
 	// causes us a lot of trouble to correct this...)
-	const float inc_limit = 8372.018089619f / o->sample_rate;
+	const float inc_limit = o->inc_limit;
 	const float inc = ( increment > inc_limit )? inc_limit:increment;
 
 	// initialize current result with 0.0
@@ -821,8 +945,6 @@ osc_get_aa_sample_exp (Oscillator *o, float increment, float sync_offset)
 	float corr_phs   = 0.0f;
 	int   corr_typ   = 1;
 
-	int i;
-
 	// update phase
 	if (sync_offset < 0.0f) {
 		o->last_phase = o->phase;
@@ -848,32 +970,11 @@ osc_get_aa_sample_exp (Oscillator *o, float increment, float sync_offset)
 	}
 
 	if (fabsf(corr_amp) > 0.00001f) { // need to correct this samples?
-		// Round-robin assignment of BLEP pipelines
-		o->bleps[o->blep_idx].ptr = 0;  // reset table-pointer to activate it
-		o->bleps[o->blep_idx].vol = corr_amp;
-		o->bleps[o->blep_idx].phs = corr_phs;
-		o->bleps[o->blep_idx].typ = corr_typ;
-		o->blep_idx = (o->blep_idx+1) % OSC_NBLEPS;
-	}
-
-	// now go through all pipelines, check if active and process if so...
-	for (i = 0; i < OSC_NBLEPS; ++i) {
-		// FIXME: When is ptr < 0?
-		// TODO: Could start at blep_idx and search until we find an expired one
-		if (o->bleps[i].ptr >= 0 && o->bleps[i].ptr < 8) {
-			const int offset = (o->bleps[i].ptr + o->bleps[i].phs) * OSC_BLEP_LEN;
-			// FIXME: EASY to remove this if
-			if (o->bleps[i].typ) {
-				value += o->bleps[i].vol * blamp_table[ offset % OSC_BLEP_SIZE ];
-			} else {
-				value += o->bleps[i].vol * blep_table[ offset % OSC_BLEP_SIZE ];
-			}
-			o->bleps[i].ptr++;
-		}
+		osc_blep_add(o, corr_amp, corr_phs, corr_typ);
 	}
 
 	// puuhh... finished here... ;-)
-	return value;
+	return osc_blep_apply(o, value);
 }
 
 
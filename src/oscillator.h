@@ -31,6 +31,13 @@
 #include "lmms_lv2.h"
 #include "lmms_math.h"
 
+// Longest sub-osc chain osc_aa_update() evaluates
+#define OSC_MAX_CHAIN  8
+
+// Highest pitch of the antialiased waves, C9.  Higher does not make any
+// musical sense and only causes trouble for the corrections.
+#define OSC_AA_MAX_FREQ 8372.018089619f
+
 // Wave-table lookup configuration
 #define OSC_WAVE_BITS  10
 #define OSC_WAVE_LEN   ((1 << OSC_WAVE_BITS) + 1)
@@ -38,6 +45,14 @@
 #define OSC_FRAC_MASK  ((1 << OSC_FRAC_BITS) - 1)
 #define OSC_FRAC_SCALE (1.0 / (1 << OSC_FRAC_BITS))
 
+// Oversampled chain rendering: factor 2 or 4, with a decimation filter of
+// OSC_DECIM_TAPS(factor) taps
+#define OSC_MAX_OVERSAMPLE     4
+#define OSC_DECIM_TAPS(factor) (32 * (factor))
+#define OSC_DECIM_MAX_TAPS     OSC_DECIM_TAPS(OSC_MAX_OVERSAMPLE)
+// Scratch osc_aa_update_os() needs for len frames
+#define OSC_OS_WORK_LEN(len)   (OSC_DECIM_MAX_TAPS + 2 * OSC_MAX_OVERSAMPLE * (len))
+
 // BLEP-table lookup configuration
 #define OSC_BLEP_SIZE 8192
 #define OSC_BLEP_LEN  (OSC_BLEP_SIZE/8)
@@ -81,12 +96,23 @@ typedef struct oscillator {
 	float phase_offset;
 	float phase;
 
+	// OSC_AA_MAX_FREQ as an increment at the rate the chain is rendered at
+	float inc_limit;
+
 	// Experimental MINBLEP stuff
 	BlepState bleps[OSC_NBLEPS];
 	int   blep_idx;
 	float phase_mod;
 	float last_phase;
 
+	// Volume ramp towards volume_target, volume_ramp frames left
+	float volume_target;
+	float volume_step;
+	int   volume_ramp;
+
+	// Noise generator, kept across resets
+	uint32_t noise;
+
 	//// HMM????
 
 	// TODO: const sampleBuffer * m_userWave;
@@ -94,6 +120,12 @@ typedef struct oscillator {
 } Oscillator;
 
 
+// Oversampled frames still in the decimation filter
+typedef struct osc_decimator {
+	float hist[OSC_DECIM_MAX_TAPS - 1];
+} OscDecimator;
+
+
 // Public interface
 
 Oscillator *osc_create();
@@ -106,16 +138,71 @@ void osc_reset (Oscillator *osc,
 
 void osc_destroy (Oscillator *o);
 
+// Start the noise sequence, oscillators with different seeds sound apart
+void osc_seed_noise (Oscillator *o, uint32_t seed);
+
+// Synthesis functions take the pitch-bend ratio of every frame in bend, or
+// bend NULL and a constant bend_ratio while the pitch-bend isn't moving
+
 // Original synthesis functions
-void osc_update (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len);
+void osc_update (Oscillator *o, sample_t *buff,
+                 const sample_t *bend, float bend_ratio, fpp_t len);
+void osc_skip (Oscillator *o, const sample_t *bend, float bend_ratio, fpp_t len);
 sample_t osc_get_sample (Oscillator *o, float sample);
 
 // Antialiased synthesis functions
-void osc_aa_update (Oscillator *o, sample_t *buff, sample_t *bend, fpp_t len);
+void osc_aa_update (Oscillator *o, sample_t *buff,
+                    const sample_t *bend, float bend_ratio, fpp_t len);
 sample_t osc_get_aa_sample (Oscillator *o, float increment, float sync_offset);
+void osc_aa_skip (Oscillator *o, const sample_t *bend, float bend_ratio, fpp_t len);
+
+// Antialiased synthesis at factor times the rate, decimated back into buff.
+// work holds OSC_OS_WORK_LEN(len) samples.
+void osc_aa_update_os (Oscillator *o, OscDecimator *d, sample_t *buff,
+                       sample_t *work, const sample_t *bend, float bend_ratio,
+                       fpp_t len, int factor);
+void osc_decimator_reset (OscDecimator *d);
 
 void osc_print (Oscillator *o);
 
+
+// Live parameter updates
+
+// Glide to a new volume over len frames
+static inline void
+osc_set_volume (Oscillator *o, float volume, int len)
+{
+	o->volume_target = volume;
+	o->volume_step   = (volume - o->volume) / len;
+	o->volume_ramp   = len;
+}
+
+static inline void
+osc_volume_tick (Oscillator *o)
+{
+	if (o->volume_ramp) {
+		o->volume += o->volume_step;
+		if (--o->volume_ramp == 0) {
+			o->volume = o->volume_target;
+		}
+	}
+}
+
+static inline void
+osc_set_freq (Oscillator *o, float freq)
+{
+	o->freq = freq / o->sample_rate;
+}
+
+// The running phase is left alone, so the new offset applies from the next
+// note.  An oscillator synced to its sub-osc restarts at it on the next sync.
+static inline void
+osc_set_phase_offset (Oscillator *o, float phase_offset)
+{
+	o->ext_phase_offset = phase_offset;
+	o->phase_offset     = phase_offset;
+}
+
 // Waveform sample routines
 
 static inline sample_t
@@ -176,13 +263,13 @@ osc_sample_exp (const float ph)
 }
 
 static inline sample_t
-osc_sample_noise (const float sample)
+osc_sample_noise (uint32_t *state)
 {
 	// Precise implementation
 	// return 1.0f - rand() * 2.0f / RAND_MAX;
 
 	// Fast implementation
-	return 1.0f - fast_rand() * 2.0f / FAST_RAND_MAX;
+	return 1.0f - fast_rand(state) * 2.0f / FAST_RAND_MAX;
 }
 
 #endif
@@ -1,12 +1,15 @@
+#define _GNU_SOURCE
+
 #include <assert.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "lmms_lv2.h"
-#include "cc_filters.h"
 #include "uris.h"
 #include "envelope.h"
 #include "oscillator.h"
@@ -26,55 +29,282 @@ triposc_map_uri (TripleOscillator *plugin, const char *uri)
 }
 
 
+// Read the oscillator unit ports once per block and recalculate the derived
+// values of the units whose ports changed.  Returns true if any did.
+static bool
+triposc_snapshot_units (TripleOscillator *triposc)
+{
+	bool changed = false;
+
+	for (int i=0; i<3; ++i) {
+		OscillatorUnit *u = &triposc->units[i];
+		const float in[] = {
+			*u->vol_port, *u->pan_port, *u->detune_coarse_port,
+			*u->detune_fine_l_port, *u->detune_fine_r_port,
+			*u->phase_offset_port, *u->phase_detune_port
+		};
+
+		if (triposc->units_valid && !memcmp(in, u->inputs, sizeof(in))) {
+			continue;
+		}
+		memcpy(u->inputs, in, sizeof(in));
+		changed = true;
+
+		// Combine volume and panning
+		if (*u->pan_port >= 0.0f ) {
+			u->m_volumeLeft  = ( *u->vol_port * (PAN_MAX - *u->pan_port) ) /
+			                   ( PAN_MAX * VOL_MAX );
+			u->m_volumeRight = *u->vol_port / VOL_MAX;
+		} else {
+			u->m_volumeLeft  = *u->vol_port / VOL_MAX;
+			u->m_volumeRight = ( *u->vol_port * (PAN_MAX + *u->pan_port) ) /
+			                   ( PAN_MAX * VOL_MAX);
+		}
+
+		u->m_volume   = *u->vol_port / VOL_MAX;
+		u->m_panLeft  = q_min(PAN_MAX - *u->pan_port, PAN_MAX) / PAN_MAX;
+		u->m_panRight = q_min(PAN_MAX + *u->pan_port, PAN_MAX) / PAN_MAX;
+
+		u->m_detuningLeft  = powf( 2.0f, (*u->detune_coarse_port * 100.0f + *u->detune_fine_l_port) / 1200.0f);
+		u->m_detuningRight = powf( 2.0f, (*u->detune_coarse_port * 100.0f + *u->detune_fine_r_port) / 1200.0f);
+
+		u->m_phaseOffsetLeft  = (*u->phase_offset_port + *u->phase_detune_port) / 360.0f;
+		// FIXME: Double check this code.  Form is different than line above
+		u->m_phaseOffsetRight = *u->phase_offset_port / 360.0f;
+	}
+	triposc->units_valid = true;
+	return changed;
+}
+
+
+// Volumes of a unit's oscillators for a note of the given velocity, panned
+// to each side and unpanned
+static inline void
+triposc_unit_volumes (const OscillatorUnit *u, uint8_t velocity,
+                      float *vol_l, float *vol_r, float *vol)
+{
+	// COMPATIBILITY: We apply velocity pre-filter, I believe LMMS wraps
+	// velocity into the same volume adjustment used by the envelope.  I
+	// prefer our method.
+	*vol_l = u->m_volumeLeft;
+	*vol_r = u->m_volumeRight;
+	*vol   = u->m_volume;
+	*vol_l *= ((float)velocity) / 127.0;
+	*vol_r *= ((float)velocity) / 127.0;
+	*vol   *= ((float)velocity) / 127.0;
+}
+
+
+// Whether a unit's left and right oscillators would render the same samples
+// but for the pan.  Noise isn't, both channels draw their own random values.
+static inline bool
+triposc_unit_mono (const OscillatorUnit *u, float wave_shape)
+{
+	return u->m_detuningLeft    == u->m_detuningRight
+	    && u->m_phaseOffsetLeft == u->m_phaseOffsetRight
+	    && (int)wave_shape != OSC_WAVE_NOISE;
+}
+
+
+// Whether the pan of a voice's chain can be applied to its output, and the
+// gain on each side if so.  Mixed units must share a pan, AM multiplies the
+// pans and a sub-chain that modulates must not be panned at all.
+static bool
+triposc_chain_pan (const TripleOscillator *triposc, const TripOscGenerator *g,
+                   float *gain_l, float *gain_r)
+{
+	float l = triposc->units[2].m_panLeft;
+	float r = triposc->units[2].m_panRight;
+
+	for (int i=1; i>=0; --i) {
+		const OscillatorUnit *u = &triposc->units[i];
+
+		switch ((int)g->osc_l[i].modulation_algo) {
+		case OSC_MOD_MIX:
+			if (u->m_panLeft != l || u->m_panRight != r) {
+				return false;
+			}
+			break;
+		case OSC_MOD_AM:
+			l *= u->m_panLeft;
+			r *= u->m_panRight;
+			break;
+		default:
+			if (l != 1.0f || r != 1.0f) {
+				return false;
+			}
+			l = u->m_panLeft;
+			r = u->m_panRight;
+			break;
+		}
+	}
+	*gain_l = l;
+	*gain_r = r;
+	return true;
+}
+
+
+// Scale an oscillator's volume, with any glide in progress
+static inline void
+triposc_osc_gain (Oscillator *o, float gain)
+{
+	o->volume        *= gain;
+	o->volume_target *= gain;
+	o->volume_step   *= gain;
+}
+
+
+// Upper bound of the oscillators' output level, for culling
+static void
+trip_osc_voice_peak (TripOscGenerator *g)
+{
+	for (int i=2; i>=0; --i) {
+		const float vol = q_max(g->osc_l[i].volume_target, g->osc_r[i].volume_target);
+		const int   mod = (int)g->osc_l[i].modulation_algo;
+
+		// Combined with its sub-osc
+		if (i == 2) {
+			g->peak = vol;
+		} else if (mod == OSC_MOD_MIX) {
+			g->peak = vol + g->peak;
+		} else if (mod == OSC_MOD_AM) {
+			g->peak = vol * g->peak;
+		} else {
+			// Sub-osc only modulates
+			g->peak = vol;
+		}
+	}
+}
+
+
+// Quality of the quality port, or the best while the host freewheels
+static inline int
+triposc_quality (const TripleOscillator *triposc)
+{
+	if (*triposc->freewheel_port > 0.5f) {
+		return QUALITY_HIGH;
+	}
+	return t_limit((int)(*triposc->quality_port + 0.5f), QUALITY_DRAFT, QUALITY_HIGH);
+}
+
+
 static void
 trip_osc_voice_steal (TripleOscillator *triposc, Voice *v, uint8_t velocity)
 {
-	TripOscGenerator *g = (TripOscGenerator*)v->generator;
+	TripOscGenerator *g = &((TripOscVoice *)v)->g;
 
 	// Init note
-	float freq  = powf(2.0f, ((float)v->midi_note-69.0f) / 12.0f) * 440.0f;
+	g->freq     = powf(2.0f, ((float)v->midi_note-69.0f) / 12.0f) * 440.0f;
+	g->velocity = velocity;
+	g->mono     = true;
+
+	// Unpanned volumes, for a mono voice
+	float vols[3];
 
 	// Reset oscillators backwards, wee...
 	for (int i=2; i>=0; --i) {
 		OscillatorUnit *u = &triposc->units[i];
 		float mod = (i==2)? 0 : *u->modulation_port;
-		// FIXME: Detuning needs to happen occasionally even after note-on
-		float detune_l = powf( 2.0f, (*u->detune_coarse_port * 100.0f + *u->detune_fine_l_port) / 1200.0f);
-		float detune_r = powf( 2.0f, (*u->detune_coarse_port * 100.0f + *u->detune_fine_r_port) / 1200.0f);
-		// FIXME: Volume/panning changes also need to happen occasionally after note-on
 		float vol_l, vol_r;
-		
-		// Combine volume and panning
-		if (*u->pan_port >= 0.0f ) {
-			vol_l = ( *u->vol_port * (PAN_MAX - *u->pan_port) ) /
-			        ( PAN_MAX * VOL_MAX );
-			vol_r = *u->vol_port / VOL_MAX;
-		} else {
-			vol_l = *u->vol_port / VOL_MAX;
-			vol_r = ( *u->vol_port * (PAN_MAX + *u->pan_port) ) /
-			        ( PAN_MAX * VOL_MAX);
-		}
-		// Apply velocity
-		// COMPATIBILITY: We apply velocity pre-filter, I believe LMMS wraps
-		// velocity into the same volume adjustment used by the envelope.  I
-		// prefer our method.
-		vol_l *= ((float)velocity) / 127.0;
-		vol_r *= ((float)velocity) / 127.0;
-
-		// FIXME: Yet another thing that *should* changed during playback?
-		float po_l = (*u->phase_offset_port + *u->phase_detune_port) / 360.0f;
-		// FIXME: Double check this code.  Form is different than line above
-		float po_r = *u->phase_offset_port / 360.0f;
+
+		triposc_unit_volumes(u, velocity, &vol_l, &vol_r, &vols[i]);
+		g->mono = g->mono && triposc_unit_mono(u, *u->wave_shape_port);
+		g->pan_l[i] = u->m_panLeft;
+		g->pan_r[i] = u->m_panRight;
 
 		osc_reset(&(g->osc_l[i]), *u->wave_shape_port, mod,
-		          freq * detune_l, vol_l,
-		          i==2?NULL:&(g->osc_l[i+1]), po_l,
+		          g->freq * u->m_detuningLeft, vol_l,
+		          i==2?NULL:&(g->osc_l[i+1]), u->m_phaseOffsetLeft,
 		          triposc->srate);
 		osc_reset(&(g->osc_r[i]), *u->wave_shape_port, mod,
-		          freq * detune_r, vol_r,
-		          i==2?NULL:&(g->osc_r[i+1]), po_r,
+		          g->freq * u->m_detuningRight, vol_r,
+		          i==2?NULL:&(g->osc_r[i+1]), u->m_phaseOffsetRight,
 		          triposc->srate);
 	}
+
+	// A mono voice renders its left chain unpanned
+	g->mono = g->mono && triposc_chain_pan(triposc, g, &g->gain_l, &g->gain_r);
+	if (g->mono) {
+		for (int i=0; i<3; ++i) {
+			g->osc_l[i].volume = g->osc_l[i].volume_target = vols[i];
+		}
+	}
+	trip_osc_voice_peak(g);
+
+	// Quality is taken at note-on, the naive and antialiased oscillators
+	// keep their phase differently
+	const int quality = triposc_quality(triposc);
+	g->naive = quality == QUALITY_DRAFT || triposc->gov_level >= 2;
+
+	// Chains with phase or frequency modulation alias the most, render
+	// them oversampled if asked to
+	g->oversample = 1;
+	for (int i=0; i<2 && !g->naive; ++i) {
+		const int mod = (int)g->osc_l[i].modulation_algo;
+		if (mod == OSC_MOD_PM || mod == OSC_MOD_FM) {
+			g->oversample = (*triposc->fm_oversample_port >= 4.0f) ? 4
+			              : (*triposc->fm_oversample_port >= 2.0f) ? 2 : 1;
+			if (quality == QUALITY_HIGH) {
+				g->oversample = q_max(g->oversample, 2);
+			}
+		}
+	}
+	if (g->oversample > 1) {
+		osc_decimator_reset(&g->dec[0]);
+		osc_decimator_reset(&g->dec[1]);
+	}
+}
+
+
+// Apply changed oscillator unit values to a sounding voice.  Volumes glide
+// over PARAM_RAMP_LEN frames and detuning is a click-free step.  Phase
+// offsets apply from the next note, only a synced oscillator picks them up
+// at its next sync.  A mono voice turns stereo when the channels start to
+// differ or the chain's pan changes, but only a new note turns mono.
+static void
+trip_osc_voice_update (TripleOscillator *triposc, Voice *v)
+{
+	TripOscGenerator *g = &((TripOscVoice *)v)->g;
+	bool  mono = true;
+	float gain_l, gain_r;
+
+	for (int i=0; i<3; ++i) {
+		mono = mono && triposc_unit_mono(&triposc->units[i], g->osc_l[i].wave_shape);
+	}
+	mono = mono && triposc_chain_pan(triposc, g, &gain_l, &gain_r)
+	            && gain_l == g->gain_l && gain_r == g->gain_r;
+
+	// Leaving mono: the right oscillators pick up where the left ones are,
+	// and both take on the pan that was applied to the chain's output
+	if (g->mono && !mono) {
+		for (int i=0; i<3; ++i) {
+			g->osc_r[i] = g->osc_l[i];
+			g->osc_r[i].sub_osc = (i==2)? NULL : &g->osc_r[i+1];
+			triposc_osc_gain(&g->osc_l[i], g->pan_l[i]);
+			triposc_osc_gain(&g->osc_r[i], g->pan_r[i]);
+		}
+		g->mono = false;
+	}
+
+	for (int i=0; i<3; ++i) {
+		const OscillatorUnit *u = &triposc->units[i];
+		float vol_l, vol_r, vol;
+
+		triposc_unit_volumes(u, g->velocity, &vol_l, &vol_r, &vol);
+		if (g->mono) {
+			vol_l = vol;
+			g->pan_l[i] = u->m_panLeft;
+			g->pan_r[i] = u->m_panRight;
+		}
+
+		osc_set_volume(&g->osc_l[i], vol_l, PARAM_RAMP_LEN);
+		osc_set_volume(&g->osc_r[i], vol_r, PARAM_RAMP_LEN);
+		osc_set_freq(&g->osc_l[i], g->freq * u->m_detuningLeft);
+		osc_set_freq(&g->osc_r[i], g->freq * u->m_detuningRight);
+		osc_set_phase_offset(&g->osc_l[i], u->m_phaseOffsetLeft);
+		osc_set_phase_offset(&g->osc_r[i], u->m_phaseOffsetRight);
+	}
+	trip_osc_voice_peak(g);
 }
 
 
@@ -85,126 +315,261 @@ trip_osc_voice_release (TripleOscillator *triposc, Voice *v)
 }
 
 
-Voice*
-voice_steal (TripleOscillator *triposc, uint8_t midi_note, uint8_t velocity)
+// Voices in use, as set by the polyphony port and cut back by the governor
+static uint32_t
+triposc_polyphony (const TripleOscillator *triposc)
 {
-	Voice *v;
-	int victim_q, victim_f, victim_idx, q, i;
-	uint32_t f;
+	const int n = t_limit((int)*triposc->polyphony_port, 1, (int)triposc->npool);
+	return q_max(n * (GOV_LEVELS + 1 - triposc->gov_level) / (GOV_LEVELS + 1), 1);
+}
 
-	// Find the next voice to steal
-	for (i = 0, victim_q = 0, victim_f = 0; i < NUM_VOICES; ++i) {
-		q = triposc->voices[i].env_vol->st.q;
-		f = triposc->voices[i].env_vol->st.frame;
-		if (q == 0) {
-			// Favor a non-playing voice
-			victim_idx = i;
-			break;
-		} else if ((q > victim_q) ||
-		           (q == victim_q && f > victim_f)) {
-			// Pick oldest envelope state,
-			// or in case of tie, pick the one with most frames played
-			victim_idx = i;
-			victim_q   = q;
-			victim_f   = f;
+
+static inline int
+triposc_voice_mode (const TripleOscillator *triposc)
+{
+	return t_limit((int)(*triposc->voice_mode_port + 0.5f),
+	               VOICE_MODE_POLY, VOICE_MODE_LEGATO);
+}
+
+
+// Keep track of the keys down, the newest last
+static void
+triposc_note_push (TripleOscillator *triposc, uint8_t midi_note, uint8_t velocity)
+{
+	uint32_t i, n = 0;
+
+	for (i=0; i<triposc->nheld; ++i) {
+		if (triposc->held_notes[i] != midi_note) {
+			triposc->held_notes[n]      = triposc->held_notes[i];
+			triposc->held_velocities[n] = triposc->held_velocities[i];
+			++n;
 		}
 	}
+	if (n < sizeof(triposc->held_notes)) {
+		triposc->held_notes[n]      = midi_note;
+		triposc->held_velocities[n] = velocity;
+		++n;
+	}
+	triposc->nheld = n;
+}
 
-	// Stealing
-	v = &triposc->voices[victim_idx];
-	v->midi_note = midi_note;
+
+static void
+triposc_note_pop (TripleOscillator *triposc, uint8_t midi_note)
+{
+	uint32_t i, n = 0;
+
+	for (i=0; i<triposc->nheld; ++i) {
+		if (triposc->held_notes[i] != midi_note) {
+			triposc->held_notes[n]      = triposc->held_notes[i];
+			triposc->held_velocities[n] = triposc->held_velocities[i];
+			++n;
+		}
+	}
+	triposc->nheld = n;
+}
+
+
+// (Re)start a voice on a note, delay frames into the current span
+static void
+triposc_voice_start (TripleOscillator *triposc, Voice *v, uint8_t midi_note,
+                     uint8_t velocity, uint32_t delay)
+{
+	v->midi_note   = midi_note;
+	v->fade        = 0;
+	v->delay       = delay;
+	v->release     = 0;
+	v->filter.type = *triposc->filter_type_port;
 	// Would be func-pointer or voice_steal would be called by tovs()
 	trip_osc_voice_steal(triposc, v, velocity);
 
-	// Trigger envelopes
-	envelope_trigger(v->env_vol);
-	envelope_trigger(v->env_cut);
-	envelope_trigger(v->env_res);
+	// Trigger envelopes and LFOs
+	modulation_trigger(triposc->mod, voice_index(&triposc->pool, v));
+}
 
-	// Trigger LFOs
-	// COMPATABILITY: We trigger a per-voice LFO while LMMS has one LFO
-	// per-instrument.
-	// TODO: Add option to toggle between both modes.
-	lfo_trigger(v->lfo_vol);
-	lfo_trigger(v->lfo_cut);
-	lfo_trigger(v->lfo_res);
 
-	return v;
+// Move a sounding voice to another note, keeping its envelopes, LFOs,
+// velocity and oscillator phases
+static void
+triposc_voice_legato (TripleOscillator *triposc, Voice *v, uint8_t midi_note)
+{
+	TripOscGenerator *g = &((TripOscVoice *)v)->g;
+
+	v->midi_note = midi_note;
+	g->freq = powf(2.0f, ((float)midi_note-69.0f) / 12.0f) * 440.0f;
+	trip_osc_voice_update(triposc, v);
+}
+
+
+// Note-on, delay frames into the current span.  Depending on the voice
+// mode this takes a free voice or steals the oldest releasing or held one
+// (poly), retriggers the voice already playing the note (reuse), or
+// retriggers or bends the one voice there is (mono, legato).
+void
+voice_steal (TripleOscillator *triposc, uint8_t midi_note, uint8_t velocity,
+             uint32_t delay)
+{
+	const int mode = triposc_voice_mode(triposc);
+	Voice *v = NULL;
+
+	triposc_note_push(triposc, midi_note, velocity);
+
+	if (mode == VOICE_MODE_REUSE) {
+		v = voice_pool_find(&triposc->pool, midi_note);
+	} else if (mode == VOICE_MODE_MONO || mode == VOICE_MODE_LEGATO) {
+		v = voice_pool_newest(&triposc->pool);
+
+		// Overlapping notes slide the held voice over
+		if (v && mode == VOICE_MODE_LEGATO && v->state == VOICE_HELD &&
+		    !v->fade && !v->delay) {
+			triposc_voice_legato(triposc, v, midi_note);
+			return;
+		}
+	}
+
+	if (v) {
+		voice_pool_retrigger(&triposc->pool, v);
+	} else {
+		v = voice_pool_alloc(&triposc->pool, triposc_polyphony(triposc));
+	}
+	triposc_voice_start(triposc, v, midi_note, velocity, delay);
 }
 	
 
+// Note-off.  In the mono modes the voice returns to the newest key still
+// down, if any.
 void
 voice_release (TripleOscillator *triposc, uint8_t midi_note)
 {
-	for (int i=0; i<NUM_VOICES; ++i) {
-		Voice *v = &triposc->voices[i];
+	const int mode = triposc_voice_mode(triposc);
+	Voice *v, *next;
+
+	triposc_note_pop(triposc, midi_note);
+
+	if ((mode == VOICE_MODE_MONO || mode == VOICE_MODE_LEGATO) && triposc->nheld) {
+		const uint8_t note     = triposc->held_notes[triposc->nheld - 1];
+		const uint8_t velocity = triposc->held_velocities[triposc->nheld - 1];
+
+		v = voice_pool_newest(&triposc->pool);
+		if (v && v->state == VOICE_HELD && v->midi_note == midi_note) {
+			if (mode == VOICE_MODE_LEGATO && !v->fade && !v->delay) {
+				triposc_voice_legato(triposc, v, note);
+			} else {
+				voice_pool_retrigger(&triposc->pool, v);
+				triposc_voice_start(triposc, v, note, velocity, 0);
+			}
+			return;
+		}
+	}
+
+	for (v = triposc->pool.lists[VOICE_HELD].head; v; v = next) {
+		next = v->next;
 		if (v->midi_note == midi_note) {
-			envelope_release(v->env_vol);
-			envelope_release(v->env_cut);
-			envelope_release(v->env_res);
+			// A quantized note-on still waiting to start is released
+			// when it starts, its envelopes haven't run yet
+			if (v->delay) {
+				v->release = 1;
+			} else {
+				modulation_release(triposc->mod, voice_index(&triposc->pool, v));
+			}
+			voice_pool_release(&triposc->pool, v);
 			trip_osc_voice_release(triposc, v);
 		}
 	}
 }
 
 
+// Voice has finished playing
 static void
-triposc_connect_port (LV2_Handle  instance,
-                      uint32_t    port,
-                      void       *data)
+voice_free (TripleOscillator *triposc, Voice *v)
+{
+	v->midi_note = 0xFF;
+	v->fade      = 0;
+	voice_pool_free(&triposc->pool, v);
+}
+
+
+// Is port a control input, as opposed to audio, events or an output
+static bool
+triposc_is_control (uint32_t port)
+{
+	switch (port) {
+	case PORT_CONTROL:
+	case PORT_OUT_L:
+	case PORT_OUT_R:
+	case PORT_LATENCY:
+	case PORT_LOAD:
+	case PORT_ACTIVE_VOICES:
+		return false;
+	default:
+		return port < TRIPOSC_MAX_PORTS;
+	}
+}
+
+
+// Point the field of a control input at data
+static void
+triposc_connect_control (TripleOscillator *plugin,
+                         uint32_t          port,
+                         void             *data)
 {
-	TripleOscillator *plugin = (TripleOscillator *)instance;
 	int oscidx, oscport;
 
 	// Handle Plugin-global ports
 	if (port < PORT_OSC1_VOL || port >= PORT_ENV_VOL_DEL) {
 		BEGIN_CONNECT_PORTS(port);
-		CONNECT_PORT(PORT_CONTROL, event_port, LV2_Atom_Sequence);
-		CONNECT_PORT(PORT_OUT_L, out_l_port, float);
-		CONNECT_PORT(PORT_OUT_R, out_r_port, float);
-		CONNECT_PORT(PORT_ENV_VOL_DEL, env_vol_params.del, float);
-		CONNECT_PORT(PORT_ENV_VOL_ATT, env_vol_params.att, float);
-		CONNECT_PORT(PORT_ENV_VOL_HOLD, env_vol_params.hold, float);
-		CONNECT_PORT(PORT_ENV_VOL_DEC, env_vol_params.dec, float);
-		CONNECT_PORT(PORT_ENV_VOL_SUS, env_vol_params.sus, float);
-		CONNECT_PORT(PORT_ENV_VOL_REL, env_vol_params.rel, float);
-		CONNECT_PORT(PORT_ENV_VOL_MOD, env_vol_params.mod, float);
-		CONNECT_PORT(PORT_LFO_VOL_DEL, lfo_vol_params.del, float);
-		CONNECT_PORT(PORT_LFO_VOL_ATT, lfo_vol_params.att, float);
-		CONNECT_PORT(PORT_LFO_VOL_SPD, lfo_vol_params.spd, float);
-		CONNECT_PORT(PORT_LFO_VOL_SHAPE, lfo_vol_params.shape, float);
-		CONNECT_PORT(PORT_LFO_VOL_MOD, lfo_vol_params.mod, float);
-		CONNECT_PORT(PORT_LFO_VOL_OP, lfo_vol_params.op, float);
+		CONNECT_PORT(PORT_ENV_VOL_DEL, env_params[MOD_VOL].del, float);
+		CONNECT_PORT(PORT_ENV_VOL_ATT, env_params[MOD_VOL].att, float);
+		CONNECT_PORT(PORT_ENV_VOL_HOLD, env_params[MOD_VOL].hold, float);
+		CONNECT_PORT(PORT_ENV_VOL_DEC, env_params[MOD_VOL].dec, float);
+		CONNECT_PORT(PORT_ENV_VOL_SUS, env_params[MOD_VOL].sus, float);
+		CONNECT_PORT(PORT_ENV_VOL_REL, env_params[MOD_VOL].rel, float);
+		CONNECT_PORT(PORT_ENV_VOL_MOD, env_params[MOD_VOL].mod, float);
+		CONNECT_PORT(PORT_LFO_VOL_DEL, lfo_params[MOD_VOL].del, float);
+		CONNECT_PORT(PORT_LFO_VOL_ATT, lfo_params[MOD_VOL].att, float);
+		CONNECT_PORT(PORT_LFO_VOL_SPD, lfo_params[MOD_VOL].spd, float);
+		CONNECT_PORT(PORT_LFO_VOL_SHAPE, lfo_params[MOD_VOL].shape, float);
+		CONNECT_PORT(PORT_LFO_VOL_MOD, lfo_params[MOD_VOL].mod, float);
+		CONNECT_PORT(PORT_LFO_VOL_OP, lfo_params[MOD_VOL].op, float);
 		CONNECT_PORT(PORT_FILTER_ENABLED, filter_enabled_port, float);
 		CONNECT_PORT(PORT_FILTER_TYPE, filter_type_port, float);
 		CONNECT_PORT(PORT_FILTER_CUT, filter_cut_port, float);
 		CONNECT_PORT(PORT_FILTER_RES, filter_res_port, float);
-		CONNECT_PORT(PORT_ENV_CUT_DEL, env_cut_params.del, float);
-		CONNECT_PORT(PORT_ENV_CUT_ATT, env_cut_params.att, float);
-		CONNECT_PORT(PORT_ENV_CUT_HOLD, env_cut_params.hold, float);
-		CONNECT_PORT(PORT_ENV_CUT_DEC, env_cut_params.dec, float);
-		CONNECT_PORT(PORT_ENV_CUT_SUS, env_cut_params.sus, float);
-		CONNECT_PORT(PORT_ENV_CUT_REL, env_cut_params.rel, float);
-		CONNECT_PORT(PORT_ENV_CUT_MOD, env_cut_params.mod, float);
-		CONNECT_PORT(PORT_LFO_CUT_DEL, lfo_cut_params.del, float);
-		CONNECT_PORT(PORT_LFO_CUT_ATT, lfo_cut_params.att, float);
-		CONNECT_PORT(PORT_LFO_CUT_SPD, lfo_cut_params.spd, float);
-		CONNECT_PORT(PORT_LFO_CUT_SHAPE, lfo_cut_params.shape, float);
-		CONNECT_PORT(PORT_LFO_CUT_MOD, lfo_cut_params.mod, float);
-		CONNECT_PORT(PORT_LFO_CUT_OP, lfo_cut_params.op, float);
-		CONNECT_PORT(PORT_ENV_RES_DEL, env_res_params.del, float);
-		CONNECT_PORT(PORT_ENV_RES_ATT, env_res_params.att, float);
-		CONNECT_PORT(PORT_ENV_RES_HOLD, env_res_params.hold, float);
-		CONNECT_PORT(PORT_ENV_RES_DEC, env_res_params.dec, float);
-		CONNECT_PORT(PORT_ENV_RES_SUS, env_res_params.sus, float);
-		CONNECT_PORT(PORT_ENV_RES_REL, env_res_params.rel, float);
-		CONNECT_PORT(PORT_ENV_RES_MOD, env_res_params.mod, float);
-		CONNECT_PORT(PORT_LFO_RES_DEL, lfo_res_params.del, float);
-		CONNECT_PORT(PORT_LFO_RES_ATT, lfo_res_params.att, float);
-		CONNECT_PORT(PORT_LFO_RES_SPD, lfo_res_params.spd, float);
-		CONNECT_PORT(PORT_LFO_RES_SHAPE, lfo_res_params.shape, float);
-		CONNECT_PORT(PORT_LFO_RES_MOD, lfo_res_params.mod, float);
-		CONNECT_PORT(PORT_LFO_RES_OP, lfo_res_params.op, float);
+		CONNECT_PORT(PORT_ENV_CUT_DEL, env_params[MOD_CUT].del, float);
+		CONNECT_PORT(PORT_ENV_CUT_ATT, env_params[MOD_CUT].att, float);
+		CONNECT_PORT(PORT_ENV_CUT_HOLD, env_params[MOD_CUT].hold, float);
+		CONNECT_PORT(PORT_ENV_CUT_DEC, env_params[MOD_CUT].dec, float);
+		CONNECT_PORT(PORT_ENV_CUT_SUS, env_params[MOD_CUT].sus, float);
+		CONNECT_PORT(PORT_ENV_CUT_REL, env_params[MOD_CUT].rel, float);
+		CONNECT_PORT(PORT_ENV_CUT_MOD, env_params[MOD_CUT].mod, float);
+		CONNECT_PORT(PORT_LFO_CUT_DEL, lfo_params[MOD_CUT].del, float);
+		CONNECT_PORT(PORT_LFO_CUT_ATT, lfo_params[MOD_CUT].att, float);
+		CONNECT_PORT(PORT_LFO_CUT_SPD, lfo_params[MOD_CUT].spd, float);
+		CONNECT_PORT(PORT_LFO_CUT_SHAPE, lfo_params[MOD_CUT].shape, float);
+		CONNECT_PORT(PORT_LFO_CUT_MOD, lfo_params[MOD_CUT].mod, float);
+		CONNECT_PORT(PORT_LFO_CUT_OP, lfo_params[MOD_CUT].op, float);
+		CONNECT_PORT(PORT_ENV_RES_DEL, env_params[MOD_RES].del, float);
+		CONNECT_PORT(PORT_ENV_RES_ATT, env_params[MOD_RES].att, float);
+		CONNECT_PORT(PORT_ENV_RES_HOLD, env_params[MOD_RES].hold, float);
+		CONNECT_PORT(PORT_ENV_RES_DEC, env_params[MOD_RES].dec, float);
+		CONNECT_PORT(PORT_ENV_RES_SUS, env_params[MOD_RES].sus, float);
+		CONNECT_PORT(PORT_ENV_RES_REL, env_params[MOD_RES].rel, float);
+		CONNECT_PORT(PORT_ENV_RES_MOD, env_params[MOD_RES].mod, float);
+		CONNECT_PORT(PORT_LFO_RES_DEL, lfo_params[MOD_RES].del, float);
+		CONNECT_PORT(PORT_LFO_RES_ATT, lfo_params[MOD_RES].att, float);
+		CONNECT_PORT(PORT_LFO_RES_SPD, lfo_params[MOD_RES].spd, float);
+		CONNECT_PORT(PORT_LFO_RES_SHAPE, lfo_params[MOD_RES].shape, float);
+		CONNECT_PORT(PORT_LFO_RES_MOD, lfo_params[MOD_RES].mod, float);
+		CONNECT_PORT(PORT_LFO_RES_OP, lfo_params[MOD_RES].op, float);
+		CONNECT_PORT(PORT_CULL_THRESHOLD, cull_threshold_port, float);
+		CONNECT_PORT(PORT_POLYPHONY, polyphony_port, float);
+		CONNECT_PORT(PORT_PIPELINE, pipeline_port, float);
+		CONNECT_PORT(PORT_EVENT_GRID, event_grid_port, float);
+		CONNECT_PORT(PORT_FM_OVERSAMPLE, fm_oversample_port, float);
+		CONNECT_PORT(PORT_QUALITY, quality_port, float);
+		CONNECT_PORT(PORT_GOVERNOR, governor_port, float);
+		CONNECT_PORT(PORT_FREEWHEEL, freewheel_port, float);
+		CONNECT_PORT(PORT_VOICE_MODE, voice_mode_port, float);
 		END_CONNECT_PORTS();
 		return;
 	// Calculate osc index of osc-specific ports
@@ -234,74 +599,202 @@ triposc_connect_port (LV2_Handle  instance,
 	END_CONNECT_PORTS();
 }
 
+
+static void
+triposc_connect_port (LV2_Handle  instance,
+                      uint32_t    port,
+                      void       *data)
+{
+	TripleOscillator *plugin = (TripleOscillator *)instance;
+
+	// Control inputs are only read through triposc_copy_controls()
+	if (triposc_is_control(port)) {
+		plugin->host_controls[port] = (const float *)data;
+		return;
+	}
+
+	BEGIN_CONNECT_PORTS(port);
+	CONNECT_PORT(PORT_CONTROL, event_port, LV2_Atom_Sequence);
+	CONNECT_PORT(PORT_OUT_L, out_l_port, float);
+	CONNECT_PORT(PORT_OUT_R, out_r_port, float);
+	CONNECT_PORT(PORT_LATENCY, latency_port, float);
+	CONNECT_PORT(PORT_LOAD, load_port, float);
+	CONNECT_PORT(PORT_ACTIVE_VOICES, active_voices_port, float);
+	END_CONNECT_PORTS();
+}
+
+
+// Take the values of all connected control inputs for this run
+static void
+triposc_copy_controls (TripleOscillator *plugin)
+{
+	for (uint32_t i = 0; i < TRIPOSC_MAX_PORTS; ++i) {
+		if (plugin->host_controls[i]) {
+			plugin->controls[i] = *plugin->host_controls[i];
+		}
+	}
+}
+
 static void
 triposc_cleanup (LV2_Handle instance)
 {
 	TripleOscillator *plugin = (TripleOscillator *)instance;
 
-	free(plugin->voices[0].generator);
-	free(plugin->voices);
+	// Joins the helper after any block it is still rendering
+	if (plugin->pipeline) {
+		worker_pool_destroy(plugin->pipeline);
+	}
+	if (plugin->workers) {
+		worker_pool_destroy(plugin->workers);
+	}
+	if (plugin->freewheel_workers) {
+		worker_pool_destroy(plugin->freewheel_workers);
+	}
+	modulation_destroy(plugin->mod);
+	aligned_free(plugin->voices);
+	aligned_free(plugin->arena);
+	free(plugin->finished);
 	free(plugin);
 }
 
 
+// Start the voice rendering threads.  Their count comes from the
+// workerThreads option, or the workerCpus option which also pins them.
+// With neither, threads for the other CPUs are started for freewheeling;
+// like the others they wait parked until run() needs them.
+static int
+triposc_start_workers (TripleOscillator *plugin, int nthreads,
+                       const int *cpus, int ncpus)
+{
+	WorkerPool **pool = &plugin->workers;
+
+	if (nthreads < 0) {
+		nthreads = ncpus;
+
+		// Nothing set up: freewheeling may still use the other CPUs
+		if (nthreads == 0) {
+			const long online = sysconf(_SC_NPROCESSORS_ONLN);
+			nthreads = t_limit(online - 1, 0, FREEWHEEL_MAX_THREADS);
+			pool     = &plugin->freewheel_workers;
+		}
+	}
+	if (nthreads == 0) {
+		return 0;
+	}
+
+	*pool = worker_pool_create(nthreads, ncpus ? cpus : NULL, ncpus);
+	if (!*pool) {
+		return -1;
+	}
+
+	// No threads on a single CPU, render on the host thread only
+	if (worker_pool_size(*pool) < 2) {
+		worker_pool_destroy(*pool);
+		*pool = NULL;
+	}
+	return 0;
+}
+
+
+// Start the helper thread for pipelined mode.  There is none on a single
+// CPU, blocks are rendered directly then.
+static int
+triposc_start_pipeline (TripleOscillator *plugin)
+{
+	plugin->pipeline = worker_pool_create(1, NULL, 0);
+	if (!plugin->pipeline) {
+		return -1;
+	}
+	if (worker_pool_size(plugin->pipeline) < 2) {
+		worker_pool_destroy(plugin->pipeline);
+		plugin->pipeline = NULL;
+	}
+	return 0;
+}
+
+
+// Allocate all audio buffers of run() in one cache-line aligned arena, so
+// run() never keeps audio on the stack.  Every buffer is a multiple of a
+// cache line long.
+static int
+triposc_alloc_arena (TripleOscillator *plugin)
+{
+	const WorkerPool *pool = plugin->workers ? plugin->workers
+	                       : plugin->freewheel_workers;
+	const uint32_t nparticipants = pool ? worker_pool_size(pool) : 1;
+	const uint32_t stage_len     = (plugin->max_block + 15) & ~15;
+	float *a;
+
+	// Smallest power of two holding two of the longest blocks
+	plugin->ring_len = 16;
+	while (plugin->ring_len < 2 * plugin->max_block) {
+		plugin->ring_len <<= 1;
+	}
+
+	a = aligned_malloc(sizeof(float) * (FREEWHEEL_SPAN
+	                                    + nparticipants * SCRATCH_LEN
+	                                    + (nparticipants - 1) * 2 * FREEWHEEL_SPAN
+	                                    + 2 * plugin->ring_len
+	                                    + 2 * stage_len)
+	                   + PIPELINE_EVENT_BYTES, CACHE_LINE_SIZE);
+	if (!a) {
+		return -1;
+	}
+
+	plugin->arena       = a;
+	plugin->bendbuf     = a;
+	plugin->scratch     = plugin->bendbuf + FREEWHEEL_SPAN;
+	plugin->wbuf        = plugin->scratch + nparticipants * SCRATCH_LEN;
+	plugin->ring        = plugin->wbuf + (nparticipants - 1) * 2 * FREEWHEEL_SPAN;
+	plugin->stage       = plugin->ring + 2 * plugin->ring_len;
+	plugin->pipe_events = (LV2_Atom_Sequence *)(plugin->stage + 2 * stage_len);
+	return 0;
+}
+
+
 static LV2_Handle
 triposc_instantiate (const LV2_Descriptor     *descriptor,
                      double                    rate,
                      const char               *path,
                      const LV2_Feature * const *features)
 {
+	const LV2_Options_Option *options = NULL;
+	int nthreads = -1;
+	int cpus[MAX_WORKER_CPUS];
+	int ncpus = 0;
 	int i;
 	
 	// Malloc and initialize new Synth
-	TripleOscillator *plugin = (TripleOscillator *)malloc(sizeof(TripleOscillator));
+	TripleOscillator *plugin = (TripleOscillator *)calloc(1, sizeof(TripleOscillator));
 	if (!plugin) {
 		fprintf(stderr, "lmms-lv2: Could not allocate TripleOscillator.\n");
 		return NULL;
 	}
 
-	plugin->env_vol_params.time_base =
-	plugin->env_cut_params.time_base =
-	plugin->env_res_params.time_base = rate;
-
-	plugin->lfo_vol_params.time_base =
-	plugin->lfo_cut_params.time_base =
-	plugin->lfo_res_params.time_base = rate;
-
-	plugin->pitch_bend = plugin->pitch_bend_lagged = 1.0f;
-
-	TripOscGenerator *generators = malloc(sizeof(TripOscGenerator) * NUM_VOICES);
-
-	// Malloc voices
-	plugin->voices = malloc(sizeof(Voice) * NUM_VOICES);
-	if (!plugin->voices || !generators) {
-		fprintf(stderr, "lmms-lv2: Could not allocate TripleOscillator voices.\n");
-		goto fail;
+	for (i=0; i<MOD_NTARGETS; ++i) {
+		plugin->env_params[i].time_base = rate;
+		plugin->lfo_params[i].time_base = rate;
 	}
-	for (i=0; i<NUM_VOICES; ++i) {
-		plugin->voices[i].midi_note = 0xFF;
-		plugin->voices[i].env_vol = envelope_create(&plugin->env_vol_params);
-		plugin->voices[i].env_cut = envelope_create(&plugin->env_cut_params);
-		plugin->voices[i].env_res = envelope_create(&plugin->env_res_params);
-		plugin->voices[i].lfo_vol = lfo_create(&plugin->lfo_vol_params);
-		plugin->voices[i].lfo_cut = lfo_create(&plugin->lfo_cut_params);
-		plugin->voices[i].lfo_res = lfo_create(&plugin->lfo_res_params);
-		plugin->voices[i].filter  = filter_create(rate);
-
-		plugin->voices[i].generator = generators + i;
-		// TODO: Split: Another callback voice_alloc and voice_free??
 
+	// Rendering reads the controls from the copy taken every run
+	for (i=0; i<TRIPOSC_MAX_PORTS; ++i) {
+		if (triposc_is_control(i)) {
+			triposc_connect_control(plugin, i, &plugin->controls[i]);
+		}
 	}
 
-	memset(&plugin->uris, 0, sizeof(plugin->uris));
+	plugin->pitch_bend = plugin->pitch_bend_lagged = 1.0f;
+	plugin->pitch_bend_steady = true;
 
 	// TODO: Split: part of general-instrument init!!
 	plugin->srate      = rate;
 
-	// Scan host features for URID map and map everything
+	// Scan host features for URID map and options
 	for (i = 0; features[i]; ++i) {
 		if (!strcmp(features[i]->URI, LV2_URID__map)) {
 			plugin->map = (LV2_URID_Map*)features[i]->data;
+		} else if (!strcmp(features[i]->URI, LV2_OPTIONS__options)) {
+			options = (const LV2_Options_Option*)features[i]->data;
 		}
 	}
 
@@ -312,126 +805,634 @@ triposc_instantiate (const LV2_Descriptor     *descriptor,
 
 	plugin->uris.midi_event   = triposc_map_uri(plugin, MIDI_EVENT_URI);
 	plugin->uris.atom_message = triposc_map_uri(plugin, ATOM_MESSAGE_URI);
+	plugin->uris.atom_int     = triposc_map_uri(plugin, ATOM_INT_URI);
+	plugin->uris.atom_vector  = triposc_map_uri(plugin, ATOM_VECTOR_URI);
+	plugin->uris.polyphony    = triposc_map_uri(plugin, POLYPHONY_OPTION_URI);
+	plugin->uris.worker_threads = triposc_map_uri(plugin, WORKER_THREADS_OPTION_URI);
+	plugin->uris.worker_cpus  = triposc_map_uri(plugin, WORKER_CPUS_OPTION_URI);
+	plugin->uris.max_block    = triposc_map_uri(plugin, MAX_BLOCK_LENGTH_URI);
+
+	// Size of the voice pool, up to the compile-time ceiling
+	plugin->npool     = NUM_VOICES;
+	plugin->max_block = DEFAULT_MAX_BLOCK;
+	for (i = 0; options && options[i].key; ++i) {
+		if (options[i].key  == plugin->uris.polyphony &&
+		    options[i].type == plugin->uris.atom_int) {
+			const int32_t n = *(const int32_t*)options[i].value;
+			plugin->npool = t_limit(n, 1, NUM_VOICES);
+		} else if (options[i].key  == plugin->uris.worker_threads &&
+		           options[i].type == plugin->uris.atom_int) {
+			nthreads = q_max(*(const int32_t*)options[i].value, 0);
+		} else if (options[i].key  == plugin->uris.worker_cpus &&
+		           options[i].type == plugin->uris.atom_vector &&
+		           options[i].size >= sizeof(LV2_Atom_Vector_Body)) {
+			const LV2_Atom_Vector_Body *vec = (const LV2_Atom_Vector_Body*)options[i].value;
+			const int32_t *cpu = (const int32_t *)(vec + 1);
+			if (vec->child_type == plugin->uris.atom_int &&
+			    vec->child_size == sizeof(int32_t)) {
+				ncpus = q_min((options[i].size - sizeof(*vec)) / sizeof(int32_t),
+				              MAX_WORKER_CPUS);
+				for (int c=0; c<ncpus; ++c) {
+					cpus[c] = cpu[c];
+				}
+			}
+		} else if (options[i].key  == plugin->uris.max_block &&
+		           options[i].type == plugin->uris.atom_int) {
+			const int32_t n = *(const int32_t*)options[i].value;
+			plugin->max_block = t_limit(n, 1, MAX_BLOCK_LIMIT);
+		}
+	}
+
+	// Malloc voices, one cache-line aligned block each
+	plugin->voices = aligned_malloc(sizeof(TripOscVoice) * plugin->npool, CACHE_LINE_SIZE);
+	plugin->mod    = modulation_create(plugin->env_params, plugin->lfo_params, plugin->npool);
+	plugin->finished = calloc(plugin->npool, sizeof(uint8_t));
+	if (!plugin->voices || !plugin->mod || !plugin->finished) {
+		fprintf(stderr, "lmms-lv2: Could not allocate TripleOscillator voices.\n");
+		goto fail;
+	}
+	for (i=0; i<plugin->npool; ++i) {
+		Voice *v = &plugin->voices[i].v;
+		TripOscGenerator *g = &plugin->voices[i].g;
+		v->midi_note = 0xFF;
+		v->fade      = 0;
+		filter_reset(&v->filter, rate);
+		// Every oscillator gets its own noise, voices may run on any thread
+		for (int j=0; j<3; ++j) {
+			osc_seed_noise(&g->osc_l[j], 6*i + 2*j + 1);
+			osc_seed_noise(&g->osc_r[j], 6*i + 2*j + 2);
+		}
+		// TODO: Split: Another callback voice_alloc and voice_free??
+	}
+	voice_pool_init(&plugin->pool, plugin->voices, sizeof(TripOscVoice), plugin->npool);
+
+	if (triposc_start_workers(plugin, nthreads, cpus, ncpus)) {
+		fprintf(stderr, "lmms-lv2: Could not start TripleOscillator workers.\n");
+		goto fail;
+	}
+
+	if (triposc_alloc_arena(plugin)) {
+		fprintf(stderr, "lmms-lv2: Could not allocate TripleOscillator buffers.\n");
+		goto fail;
+	}
+
+	// The pipeline helper waits parked until pipelined mode is switched on
+	if (triposc_start_pipeline(plugin)) {
+		fprintf(stderr, "lmms-lv2: Could not start TripleOscillator pipeline.\n");
+		goto fail;
+	}
 
 	return (LV2_Handle)plugin;
 
 fail:
+	if (plugin->pipeline) {
+		worker_pool_destroy(plugin->pipeline);
+	}
+	if (plugin->workers) {
+		worker_pool_destroy(plugin->workers);
+	}
+	if (plugin->freewheel_workers) {
+		worker_pool_destroy(plugin->freewheel_workers);
+	}
+	if (plugin->mod) {
+		modulation_destroy(plugin->mod);
+	}
+	aligned_free(plugin->voices);
+	aligned_free(plugin->arena);
+	free(plugin->finished);
 	free(plugin);
 	return 0;
 }
 
 
+// Upper bound of a voice's current output power.  Bound the level by the
+// volume envelope, the oscillator volumes (including velocity) and a
+// mixed-in volume LFO.
+static float
+triposc_voice_level (const TripleOscillator *plugin, Voice *v)
+{
+	const TripOscGenerator *g = &((TripOscVoice *)v)->g;
+	const float env_mod = *plugin->env_params[MOD_VOL].mod;
+	const float vol_amt_add = (env_mod >= 0.0f) ? 1.0f - env_mod : 1.0f;
+
+	float amp = fabsf(modulation_env_level(plugin->mod, voice_index(&plugin->pool, v), MOD_VOL)
+	                  * env_mod + vol_amt_add);
+	if (*plugin->lfo_params[MOD_VOL].op <= 0.5f) {
+		amp += fabsf(*plugin->lfo_params[MOD_VOL].mod) * 0.5f;
+	}
+	return amp * amp * g->peak;
+}
+
+
+// Render one modulation block of a voice, mixing it into out_l/out_r.
+// Returns false once the voice has finished and must be freed.
+static bool
+triposc_render_voice (TripleOscillator *plugin,
+                      Voice            *v,
+                      const float      *bend,
+                      float            *scratch,
+                      float            *out_l,
+                      float            *out_r,
+                      int               outlen)
+{
+	float *outbuf[2] = { scratch, scratch + MOD_BLOCK_LEN };
+	float *oswork    = scratch + 2 * MOD_BLOCK_LEN;
+
+	const uint32_t i = voice_index(&plugin->pool, v);
+
+	const float *envbuf_vol = modulation_buffer(plugin->mod, i, MOD_VOL);
+	const float *envbuf_cut = modulation_buffer(plugin->mod, i, MOD_CUT);
+	const float *envbuf_res = modulation_buffer(plugin->mod, i, MOD_RES);
+
+	TripOscGenerator *g = &((TripOscVoice *)v)->g;
+
+	// Amount to add to value generated by envelope
+	// For volume, the envelope is more of a "mix" than a pure mod
+	float vol_amt_add = (*plugin->env_params[MOD_VOL].mod >= 0.0f)
+	                    ? 1.0f - *plugin->env_params[MOD_VOL].mod
+	                    : 1.0f;
+
+	// Skip the leading frames where the volume is zero (e.g.
+	// envelope pre-delay at full modulation).  Oscillators are
+	// fast-forwarded, the filter and mix are not run.
+	int skip = 0;
+	while (skip < outlen && envbuf_vol[skip] + vol_amt_add == 0.0f) {
+		++skip;
+	}
+	for (int ch=0; skip > 0 && ch < (g->mono ? 1 : 2); ++ch) {
+		Oscillator *chain = ch ? &g->osc_r[0] : &g->osc_l[0];
+
+		if (g->naive) {
+			osc_skip(chain, bend, plugin->pitch_bend_lagged, skip);
+		} else {
+			osc_aa_skip(chain, bend, plugin->pitch_bend_lagged, skip);
+			// The decimator would convolve the frames before the skip
+			// into the first ones after it
+			if (g->oversample > 1) {
+				osc_decimator_reset(&g->dec[ch]);
+			}
+		}
+	}
+
+	// Render the audible remainder
+	const int    len  = outlen - skip;
+	float       *vout_l = out_l + skip;
+	float       *vout_r = out_r + skip;
+	const float *vvol = envbuf_vol + skip;
+	const float *vcut = envbuf_cut + skip;
+	const float *vres = envbuf_res + skip;
+
+	// Generate samples.  The oscillator chain renders a whole chunk at a
+	// time, everything after it is done in a single pass per frame.  Mono
+	// voices render the left chain only and pan it to both channels.
+	const float *vbend = bend ? bend + skip : NULL;
+	for (int ch=0; ch<2; ++ch) {
+		Oscillator *chain = ch ? &g->osc_r[0] : &g->osc_l[0];
+
+		if (ch && g->mono) {
+			if (g->gain_l == 1.0f && g->gain_r == 1.0f) {
+				outbuf[1] = outbuf[0];
+			} else {
+				for (int f=0; f<len; ++f) {
+					outbuf[1][f] = outbuf[0][f] * g->gain_r;
+					outbuf[0][f] *= g->gain_l;
+				}
+			}
+		} else if (g->naive) {
+			osc_update(chain, outbuf[ch], vbend, plugin->pitch_bend_lagged, len);
+		} else if (g->oversample > 1) {
+			osc_aa_update_os(chain, &g->dec[ch], outbuf[ch], oswork, vbend,
+			                 plugin->pitch_bend_lagged, len, g->oversample);
+		} else {
+			osc_aa_update(chain, outbuf[ch], vbend, plugin->pitch_bend_lagged, len);
+		}
+	}
+
+	// A culled voice fades out linearly, ending at frame v->fade
+	const float fade_step = v->fade ? 1.0f / CULL_FADE_LEN : 0.0f;
+	const float fade_0    = v->fade ? (float)v->fade / CULL_FADE_LEN : 1.0f;
+
+	// Standard filter
+	if (*plugin->filter_enabled_port > 0.5f) {
+		// Filter enabled
+		const float cut_base = *plugin->filter_cut_port;
+		const float res_base = *plugin->filter_res_port;
+
+		// Draft quality, or the governor, updates the coefficients
+		// once per tile
+		const bool per_sample = triposc_quality(plugin) != QUALITY_DRAFT &&
+		                        plugin->gov_level == 0;
+		if (!per_sample && len > 0) {
+			filter_calc_coeffs(&v->filter,
+			                   exp_knob_val(vcut[0]) * CUT_FREQ_MULTIPLIER + cut_base,
+			                   vres[0] * RES_MULTIPLIER + res_base);
+		}
+
+		for (int f=0; f<len; ++f) {
+			const float fade = q_max(fade_0 - f * fade_step, 0.0f);
+
+			// TODO: only recalc when needed (when knob changed or LFO on)
+			if (per_sample) {
+				const float cut = exp_knob_val(vcut[f]) * CUT_FREQ_MULTIPLIER
+				                  + cut_base;
+				const float res = vres[f] * RES_MULTIPLIER
+				                  + res_base;
+				filter_calc_coeffs(&v->filter, cut, res);
+			}
+
+			// The actual volume for this sample (squared mix of envelope and 1.0f)
+			float out_mod_amt = vvol[f] + vol_amt_add;
+			out_mod_amt = out_mod_amt * out_mod_amt;
+
+			vout_l[f] +=  filter_get_sample(&v->filter, outbuf[0][f] * fade, 0) * out_mod_amt;
+			vout_r[f] +=  filter_get_sample(&v->filter, outbuf[1][f] * fade, 1) * out_mod_amt;
+		}
+	} else {
+		// No Filter
+		for (int f=0; f<len; ++f) {
+			const float fade = q_max(fade_0 - f * fade_step, 0.0f);
+
+			// The actual volume for this sample (squared mix of envelope and 1.0f)
+			float out_mod_amt = vvol[f] + vol_amt_add;
+			out_mod_amt = out_mod_amt * out_mod_amt;
+
+			vout_l[f] +=  outbuf[0][f] * fade * out_mod_amt;
+			vout_r[f] +=  outbuf[1][f] * fade * out_mod_amt;
+		}
+	}
+
+	// Finished voice
+	if (!modulation_active(plugin->mod, i)) {
+		return false;
+	} else if (v->fade) {
+		// Culled voice has faded out, return it to the pool
+		if (v->fade <= len) {
+			modulation_kill(plugin->mod, i);
+			return false;
+		}
+		v->fade -= len;
+	} else if (modulation_releasing(plugin->mod, i) &&
+	           triposc_voice_level(plugin, v) < plugin->cull_level) {
+		// Cull the release tail once it is inaudible
+		v->fade = CULL_FADE_LEN;
+	}
+
+	/* TODO: Apply default release */
+	return true;
+}
+
+
+// A quantized note-on starts, with the note-off that came in meanwhile
+static inline void
+triposc_voice_begin (TripleOscillator *plugin, Voice *v, uint32_t i)
+{
+	if (v->release) {
+		v->release = 0;
+		modulation_release(plugin->mod, i);
+	}
+}
+
+
+// Render nframes (<= FREEWHEEL_SPAN) of a set of voices, one modulation block
+// at a time, with the scratch buffers of the given participant.  Voices
+// that finish are marked in plugin->finished with the block they finished
+// in and dropped; freeing them is left to the caller.
 static void
-triposc_run (LV2_Handle instance,
-             uint32_t   sample_count)
+triposc_render_voices (TripleOscillator *plugin,
+                       uint32_t          participant,
+                       const uint32_t   *voices,
+                       uint32_t          nvoices,
+                       const float      *bend,
+                       float            *out_l,
+                       float            *out_r,
+                       uint32_t          nframes)
 {
-	TripleOscillator *plugin = (TripleOscillator *)instance;
+	float   *scratch = plugin->scratch + participant * SCRATCH_LEN;
+	uint32_t nplaying = nvoices;
+	uint32_t nready;
+	uint32_t pos;
+	int      block;
+
+	if (nvoices == 0) {
+		return;
+	}
+
+	uint32_t playing[nvoices];
+	uint32_t ready[nvoices];
+
+	memcpy(playing, voices, nvoices * sizeof(uint32_t));
+
+	for (pos = 0, block = 1; pos < nframes; ++block) {
+		const int outlen = q_min(nframes - pos, MOD_BLOCK_LEN);
+		uint32_t  n = 0;
+
+		// Calculate envelopes and LFOs of the voices that are under way
+		nready = 0;
+		for (uint32_t j=0; j<nplaying; ++j) {
+			Voice *v = voice_pool_at(&plugin->pool, playing[j]);
+			if (!v->delay) {
+				triposc_voice_begin(plugin, v, playing[j]);
+				ready[nready++] = playing[j];
+			}
+		}
+		// All of them may still be waiting for their grid offset
+		if (nready > 0) {
+			modulation_run(plugin->mod, ready, nready, outlen);
+		}
+
+		// Accumulate voices
+		for (uint32_t j=0; j<nplaying; ++j) {
+			const uint32_t i = playing[j];
+			Voice *v = voice_pool_at(&plugin->pool, i);
+			const uint32_t d = v->delay;
+
+			// A quantized note-on starts at its own offset into the block
+			if (d >= (uint32_t)outlen) {
+				v->delay -= outlen;
+				playing[n++] = i;
+				continue;
+			} else if (d) {
+				v->delay = 0;
+				triposc_voice_begin(plugin, v, i);
+				modulation_run(plugin->mod, &i, 1, outlen - d);
+			}
+
+			const float *vbend = bend ? bend + pos + d : NULL;
+			if (triposc_render_voice(plugin, v, vbend, scratch,
+			                         out_l + pos + d, out_r + pos + d, outlen - d)) {
+				playing[n++] = i;
+			} else {
+				plugin->finished[i] = block;
+			}
+		}
+		nplaying = n;
+		pos += outlen;
+	}
+}
+
+
+// Worker pool job: each participant renders every nth voice
+static void
+triposc_render_job (void *arg, uint32_t participant)
+{
+	TripleOscillator *plugin = (TripleOscillator *)arg;
+	const uint32_t nthreads = worker_pool_size(plugin->job.workers);
+	uint32_t voices[plugin->job.nvoices / nthreads + 1];
+	uint32_t nvoices = 0;
+	float   *out_l, *out_r;
+
+	for (uint32_t j=participant; j<plugin->job.nvoices; j+=nthreads) {
+		voices[nvoices++] = plugin->job.voices[j];
+	}
+
+	// The host thread mixes straight into the ports, workers into their own
+	// buffer which is summed after the dispatch
+	if (participant == 0) {
+		out_l = plugin->job.out_l + plugin->job.pos;
+		out_r = plugin->job.out_r + plugin->job.pos;
+	} else {
+		out_l = plugin->wbuf + (participant - 1) * 2 * FREEWHEEL_SPAN;
+		out_r = out_l + FREEWHEEL_SPAN;
+		memset(out_l, 0, plugin->job.nframes * sizeof(float));
+		memset(out_r, 0, plugin->job.nframes * sizeof(float));
+	}
 
+	triposc_render_voices(plugin, participant, voices, nvoices,
+	                      plugin->job.bend, out_l, out_r, plugin->job.nframes);
+}
+
+
+// Fade out the quietest voices while more are sounding than the governor
+// allows.  Voices still waiting for their quantized note-on are kept.
+static void
+triposc_govern_voices (TripleOscillator *plugin)
+{
+	const uint32_t n = triposc_polyphony(plugin);
+	uint32_t sounding = 0;
+
+	for (int l=VOICE_HELD; l<=VOICE_RELEASING; ++l) {
+		for (Voice *v = plugin->pool.lists[l].head; v; v = v->next) {
+			sounding += !v->fade;
+		}
+	}
+
+	for (; sounding > n; --sounding) {
+		Voice *quietest = NULL;
+		float  level    = INFINITY;
+		for (int l=VOICE_HELD; l<=VOICE_RELEASING; ++l) {
+			for (Voice *v = plugin->pool.lists[l].head; v; v = v->next) {
+				const float vl = v->fade || v->delay ? INFINITY
+				               : triposc_voice_level(plugin, v);
+				if (vl < level) {
+					quietest = v;
+					level    = vl;
+				}
+			}
+		}
+		if (!quietest) {
+			break;
+		}
+		quietest->fade = CULL_FADE_LEN;
+	}
+}
+
+
+// Account for the time it took to render nframes.  Sustained overload
+// steps the degrade level up, sustained headroom back down.
+static void
+triposc_govern (TripleOscillator *plugin, double secs, uint32_t nframes)
+{
+	const float budget = nframes / plugin->srate;
+	const float a      = q_min(budget / GOV_SMOOTH_SECS, 1.0f);
+
+	if (nframes == 0) {
+		return;
+	}
+	plugin->load += (secs / budget - plugin->load) * a;
+
+	// Offline, running late costs nothing
+	if (*plugin->governor_port <= 0.5f || *plugin->freewheel_port > 0.5f) {
+		plugin->gov_level = 0;
+		plugin->gov_hold  = 0.0f;
+	} else if (plugin->load > GOV_LOAD_HIGH && plugin->gov_level < GOV_LEVELS) {
+		plugin->gov_hold += budget;
+		if (plugin->gov_hold >= GOV_DEGRADE_SECS) {
+			++plugin->gov_level;
+			plugin->gov_hold = 0.0f;
+		}
+	} else if (plugin->load < GOV_LOAD_LOW && plugin->gov_level > 0) {
+		plugin->gov_hold += budget;
+		if (plugin->gov_hold >= GOV_RECOVER_SECS) {
+			--plugin->gov_level;
+			plugin->gov_hold = 0.0f;
+		}
+	} else {
+		plugin->gov_hold = 0.0f;
+	}
+}
+
+
+// Render sample_count frames of the given events into out_l_port/out_r_port
+static void
+triposc_render (TripleOscillator        *plugin,
+                const LV2_Atom_Sequence *events,
+                float                   *out_l_port,
+                float                   *out_r_port,
+                uint32_t                 sample_count)
+{
 	uint32_t    pos;
 	uint32_t    ev_frames;
 
-	// TODO: Reuse buffers when possible (bendbuf+cut, vol+res)
-	float outbuf[2][sample_count];
-	float bendbuf[sample_count];
-	float envbuf_vol[sample_count];
-	float envbuf_cut[sample_count];
-	float envbuf_res[sample_count];
+	float *bendbuf = plugin->bendbuf;
+	float *bend;
+
+	uint32_t playing[plugin->npool];
+	uint32_t nplaying;
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	// Voices in release are culled once their level falls below this
+	plugin->cull_level = db_to_amp(*plugin->cull_threshold_port);
+
+	// Frames events are quantized to, 1 for sample accurate
+	const uint32_t grid = t_limit((int)*plugin->event_grid_port, 1, MAX_EVENT_GRID);
+
+	// Take in oscillator port changes, also for the voices already playing
+	if (triposc_snapshot_units(plugin)) {
+		for (int l=VOICE_HELD; l<=VOICE_RELEASING; ++l) {
+			for (Voice *v = plugin->pool.lists[l].head; v; v = v->next) {
+				trip_osc_voice_update(plugin, v);
+			}
+		}
+	}
+
+	if (plugin->gov_level > 0) {
+		triposc_govern_voices(plugin);
+	}
 
-	LV2_Atom_Event *ev = lv2_atom_sequence_begin(&plugin->event_port->body);
+	// Freewheeling renders in longer spans, on all the threads there are
+	WorkerPool *workers = plugin->workers;
+	uint32_t    span    = WORKER_SPAN;
+	if (*plugin->freewheel_port > 0.5f) {
+		span = FREEWHEEL_SPAN;
+		if (!workers) {
+			workers = plugin->freewheel_workers;
+		}
+	}
+
+	LV2_Atom_Event *ev = lv2_atom_sequence_begin(&events->body);
 
 	for (pos = 0; pos < sample_count;) {
-		// Check for next event
-		if (!lv2_atom_sequence_is_end(&plugin->event_port->body, plugin->event_port->atom.size, ev)) {
-			ev_frames = ev->time.frames;
+		// Check for next event.  With an event grid, events are applied
+		// at the grid line before them to keep spans long; note-ons still
+		// start their voice at the exact frame.
+		if (!lv2_atom_sequence_is_end(&events->body, events->atom.size, ev)) {
+			ev_frames = ev->time.frames - ev->time.frames % grid;
 		} else {
 			ev = NULL;
 			ev_frames = sample_count;
 		}
 
-		// Run until next event
-		// FIXME: This extra arithmetic is stupid to have in this loop
-		float *out_l = &plugin->out_l_port[pos];
-		float *out_r = &plugin->out_r_port[pos];
-		int    outlen = ev_frames-pos;
+		// Idle: nothing sounds until the next event, clear the span in
+		// one go and let the pitch-bend lag catch up in closed form
+		if (pos < ev_frames && !voice_pool_active(&plugin->pool)) {
+			memset(&out_l_port[pos], 0, (ev_frames - pos) * sizeof(float));
+			memset(&out_r_port[pos], 0, (ev_frames - pos) * sizeof(float));
+			if (!plugin->pitch_bend_steady) {
+				const float target = plugin->pitch_bend;
+				const float dist   = (plugin->pitch_bend_lagged - target)
+				                     * powf(PITCH_BEND_LAG, ev_frames - pos);
+				plugin->pitch_bend_lagged = target + dist;
+				if (fabsf(dist) <= PITCH_BEND_EPSILON * target) {
+					plugin->pitch_bend_lagged = target;
+					plugin->pitch_bend_steady = true;
+				}
+			}
+			pos = ev_frames;
+		}
 
-		// Zero the output buffers and fill pitch-bend
-		for (int f=0; f<outlen; ++f) {
-			out_l[f] = out_r[f] = 0.0f;
+		// Run until next event
+		while (pos < ev_frames) {
+			// FIXME: This extra arithmetic is stupid to have in this loop
+			float *out_l = &out_l_port[pos];
+			float *out_r = &out_r_port[pos];
+			int    outlen = q_min(ev_frames - pos, span);
+
+			// Zero the output buffers
+			memset(out_l, 0, outlen * sizeof(float));
+			memset(out_r, 0, outlen * sizeof(float));
+
+			// Pitch-bend approaches its target exponentially, the
+			// distance shrinking by PITCH_BEND_LAG every frame.  Once
+			// it is negligible the bend is steady and the oscillators
+			// run without a bend buffer.
+			if (plugin->pitch_bend_steady) {
+				bend = NULL;
+			} else {
+				const float target = plugin->pitch_bend;
+				float       dist   = plugin->pitch_bend_lagged - target;
+				for (int f=0; f<outlen; ++f) {
+					dist *= PITCH_BEND_LAG;
+					bendbuf[f] = target + dist;
+				}
+				plugin->pitch_bend_lagged = target + dist;
+				if (fabsf(dist) <= PITCH_BEND_EPSILON * target) {
+					plugin->pitch_bend_lagged = target;
+					plugin->pitch_bend_steady = true;
+				}
+				bend = bendbuf;
+			}
 
-			bendbuf[f] = cc_lag(&plugin->pitch_bend_lagged,
-			                    plugin->pitch_bend,
-			                    PITCH_BEND_LAG);
-		}
+			// Gather all playing voices
+			nplaying = 0;
+			for (int l=VOICE_HELD; l<=VOICE_RELEASING; ++l) {
+				for (Voice *v = plugin->pool.lists[l].head; v; v = v->next) {
+					playing[nplaying++] = voice_index(&plugin->pool, v);
+				}
+			}
 
-		// Accumulate voices
-		for (int i=0; i<NUM_VOICES; ++i) {
-			Voice *v = &plugin->voices[i];
-
-			if (v->midi_note != 0xFF) {
-				int active;
-
-				// Calculate envelopes
-				active = envelope_run(v->env_vol, envbuf_vol, outlen);
-				envelope_run(v->env_cut, envbuf_cut, outlen);
-				envelope_run(v->env_res, envbuf_res, outlen);
-
-				// Calculate LFOs
-				lfo_run(v->lfo_vol, envbuf_vol, outlen);
-				lfo_run(v->lfo_cut, envbuf_cut, outlen);
-				lfo_run(v->lfo_res, envbuf_res, outlen);
-
-				TripOscGenerator *g = (TripOscGenerator *)v->generator;
-				// TODO: Make a mixing version of the run function
-				
-				// Generate samples
-				osc_aa_update(&g->osc_l[0], outbuf[0], bendbuf, outlen);
-				osc_aa_update(&g->osc_r[0], outbuf[1], bendbuf, outlen);
-
-				// Amount to add to value generated by envelope
-				// For volume, the envelope is more of a "mix" than a pure mod
-				float vol_amt_add = (*plugin->env_vol_params.mod >= 0.0f)
-				                    ? 1.0f - *plugin->env_vol_params.mod
-				                    : 1.0f;
-
-				// Standard filter
-				if (*plugin->filter_enabled_port > 0.5f) {
-					// Filter enabled
+			if (workers && outlen >= MOD_BLOCK_LEN &&
+			    nplaying >= WORKER_MIN_VOICES * worker_pool_size(workers)) {
+				// Split the voices over the worker pool.  Each worker
+				// always sums the same subset in the same order and
+				// the partial mixes are added in worker order, so the
+				// result doesn't depend on thread timing.
+				plugin->job.workers = workers;
+				plugin->job.out_l   = out_l_port;
+				plugin->job.out_r   = out_r_port;
+				plugin->job.voices  = playing;
+				plugin->job.nvoices = nplaying;
+				plugin->job.pos     = pos;
+				plugin->job.nframes = outlen;
+				plugin->job.bend    = bend;
+				worker_pool_run(workers, triposc_render_job, plugin);
+
+				for (uint32_t w=1; w<worker_pool_size(workers); ++w) {
+					const float *wout_l = plugin->wbuf + (w - 1) * 2 * FREEWHEEL_SPAN;
+					const float *wout_r = wout_l + FREEWHEEL_SPAN;
 					for (int f=0; f<outlen; ++f) {
-						// TODO: only recalc when needed (when knob changed or LFO on)
-						const float cut = exp_knob_val(envbuf_cut[f]) * CUT_FREQ_MULTIPLIER
-						                  + *plugin->filter_cut_port;
-						const float res = envbuf_res[f] * RES_MULTIPLIER
-						                  + *plugin->filter_res_port;
-						filter_calc_coeffs(v->filter, cut, res);
-
-						// The actual volume for this sample (squared mix of envelope and 1.0f)
-						float out_mod_amt = envbuf_vol[f] + vol_amt_add;
-						out_mod_amt = out_mod_amt * out_mod_amt;
-
-						out_l[f] +=  filter_get_sample(v->filter, outbuf[0][f], 0) * out_mod_amt;
-						out_r[f] +=  filter_get_sample(v->filter, outbuf[1][f], 1) * out_mod_amt;
-					}
-				} else {
-					// No Filter
-					for (int f=0; f<outlen; ++f) {
-						// The actual volume for this sample (squared mix of envelope and 1.0f)
-						float out_mod_amt = envbuf_vol[f] + vol_amt_add;
-						out_mod_amt = out_mod_amt * out_mod_amt;
-
-						out_l[f] +=  outbuf[0][f] * out_mod_amt;
-						out_r[f] +=  outbuf[1][f] * out_mod_amt;
+						out_l[f] += wout_l[f];
+						out_r[f] += wout_r[f];
 					}
 				}
+			} else {
+				triposc_render_voices(plugin, 0, playing, nplaying, bend,
+				                      out_l, out_r, outlen);
+			}
 
-				// Kill finished voice
-				if (!active) {
-					v->midi_note = 0xFF;
+			// Return finished voices to the pool, in the order they finished
+			for (int block=1; block<=(outlen+MOD_BLOCK_LEN-1)/MOD_BLOCK_LEN; ++block) {
+				for (uint32_t j=0; j<nplaying; ++j) {
+					const uint32_t i = playing[j];
+					if (plugin->finished[i] == block) {
+						plugin->finished[i] = 0;
+						voice_free(plugin, voice_pool_at(&plugin->pool, i));
+					}
 				}
-
-				/* TODO: Apply default release */
 			}
+			pos += outlen;
 		}
-		pos = ev_frames;
 
 
 		// Process event
@@ -449,8 +1450,8 @@ triposc_run (LV2_Handle instance,
 						voice_release(plugin, data[1]);
 					} else {
 						// Yep, really Note On
-						Voice *v = voice_steal(plugin, data[1], data[2]);
-						v->filter->type = *plugin->filter_type_port;
+						voice_steal(plugin, data[1], data[2],
+						            ev->time.frames - ev_frames);
 					}
 				} else if (cmd == 0x80) {
 					// Note Off
@@ -459,6 +1460,7 @@ triposc_run (LV2_Handle instance,
 					// Pitch Bend
 					uint16_t bend = data[1] | (data[2] << 7);
 					plugin->pitch_bend = powf(2.0f, (((float)bend)/8192.0f - 1.0f) * PITCH_BEND_RANGE);
+					plugin->pitch_bend_steady = plugin->pitch_bend == plugin->pitch_bend_lagged;
 					//printf("PB 0x%x 0x%x 0x%x 0x%x    %f\n",cmd,data[1],data[2],data[3],plugin->pitch_bend);
 				} else {
 					//printf("   0x%x 0x%x 0x%x\n",cmd,data[1],data[2]);
@@ -471,6 +1473,139 @@ triposc_run (LV2_Handle instance,
 		}
 
 	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	triposc_govern(plugin, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9,
+	               sample_count);
+}
+
+
+// Pipeline helper job: render the copied events and controls of the last
+// host block into the ring
+static void
+triposc_pipeline_job (void *arg, uint32_t participant)
+{
+	TripleOscillator *plugin = (TripleOscillator *)arg;
+	const uint32_t nframes = plugin->pipe_nframes;
+	const uint32_t len     = plugin->ring_len;
+	const uint32_t w       = plugin->ring_write & (len - 1);
+	const uint32_t n1      = q_min(nframes, len - w);
+	float *stage_l = plugin->stage;
+	float *stage_r = plugin->stage + ((plugin->max_block + 15) & ~15);
+
+	triposc_render(plugin, plugin->pipe_events, stage_l, stage_r, nframes);
+
+	memcpy(plugin->ring + w, stage_l, n1 * sizeof(float));
+	memcpy(plugin->ring + len + w, stage_r, n1 * sizeof(float));
+	memcpy(plugin->ring, stage_l + n1, (nframes - n1) * sizeof(float));
+	memcpy(plugin->ring + len, stage_r + n1, (nframes - n1) * sizeof(float));
+}
+
+
+// Wait for the helper and account for the block it rendered
+static void
+triposc_pipeline_sync (TripleOscillator *plugin)
+{
+	if (plugin->pipe_busy) {
+		worker_pool_wait(plugin->pipeline);
+		plugin->ring_write += plugin->pipe_nframes;
+		plugin->pipe_busy   = false;
+	}
+}
+
+
+// Copy as much of the host's event sequence as fits into pipe_events
+static void
+triposc_pipeline_copy_events (TripleOscillator *plugin)
+{
+	const LV2_Atom_Sequence *in = plugin->event_port;
+	LV2_Atom_Sequence *out = plugin->pipe_events;
+	uint32_t size = sizeof(LV2_Atom_Sequence_Body);
+	LV2_Atom_Event *ev;
+
+	for (ev = lv2_atom_sequence_begin(&in->body);
+	     !lv2_atom_sequence_is_end(&in->body, in->atom.size, ev);
+	     ev = lv2_atom_sequence_next(ev)) {
+		const uint32_t ev_size = lv2_atom_pad_size(sizeof(LV2_Atom_Event) + ev->body.size);
+		if (sizeof(LV2_Atom) + size + ev_size > PIPELINE_EVENT_BYTES) {
+			// Out of room, the remaining events are dropped
+			break;
+		}
+		memcpy((char *)LV2_ATOM_BODY(out) + size, ev, sizeof(LV2_Atom_Event) + ev->body.size);
+		size += ev_size;
+	}
+	out->atom.type = in->atom.type;
+	out->atom.size = size;
+	out->body      = in->body;
+}
+
+
+// Pipelined run: hand out the block the helper rendered during the last
+// call and start it on this call's events.  Output lags by the largest
+// block seen so far, which is reported on the latency port.  The helper
+// must be idle and the controls copied.
+static void
+triposc_run_pipelined (TripleOscillator *plugin,
+                       uint32_t          sample_count)
+{
+	const uint32_t len = plugin->ring_len;
+	uint32_t avail, n, r, n1;
+
+	*plugin->load_port          = plugin->load * 100.0f;
+	*plugin->active_voices_port = voice_pool_active(&plugin->pool);
+
+	// Blocks rendered ahead, but never more than this one asks for.  A
+	// shortfall (the first block, or one longer than any before) is
+	// padded with silence and the latency grows to match.
+	avail = q_min(plugin->ring_write - plugin->ring_read, sample_count);
+	n     = sample_count - avail;
+	r     = plugin->ring_read & (len - 1);
+	n1    = q_min(avail, len - r);
+
+	memset(plugin->out_l_port, 0, n * sizeof(float));
+	memset(plugin->out_r_port, 0, n * sizeof(float));
+	memcpy(plugin->out_l_port + n, plugin->ring + r, n1 * sizeof(float));
+	memcpy(plugin->out_r_port + n, plugin->ring + len + r, n1 * sizeof(float));
+	memcpy(plugin->out_l_port + n + n1, plugin->ring, (avail - n1) * sizeof(float));
+	memcpy(plugin->out_r_port + n + n1, plugin->ring + len, (avail - n1) * sizeof(float));
+	plugin->ring_read += avail;
+
+	// Render this block ahead
+	triposc_pipeline_copy_events(plugin);
+	plugin->pipe_nframes = sample_count;
+	plugin->pipe_busy    = true;
+	worker_pool_start(plugin->pipeline, triposc_pipeline_job, plugin);
+
+	*plugin->latency_port = plugin->ring_write + sample_count - plugin->ring_read;
+}
+
+
+static void
+triposc_run (LV2_Handle instance,
+             uint32_t   sample_count)
+{
+	TripleOscillator *plugin = (TripleOscillator *)instance;
+
+	// The helper may still be rendering from the last copy of the controls
+	triposc_pipeline_sync(plugin);
+	triposc_copy_controls(plugin);
+
+	if (*plugin->pipeline_port > 0.5f && sample_count <= plugin->max_block &&
+	    plugin->pipeline) {
+		triposc_run_pipelined(plugin, sample_count);
+		return;
+	}
+
+	// Leaving pipelined mode, or a block longer than the host promised: the
+	// audio still in flight is dropped.  Direct rendering works through
+	// blocks of any length in WORKER_SPAN pieces.
+	plugin->ring_read = plugin->ring_write = 0;
+
+	triposc_render(plugin, plugin->event_port,
+	               plugin->out_l_port, plugin->out_r_port, sample_count);
+	*plugin->latency_port       = 0.0f;
+	*plugin->load_port          = plugin->load * 100.0f;
+	*plugin->active_voices_port = voice_pool_active(&plugin->pool);
 }
 
 
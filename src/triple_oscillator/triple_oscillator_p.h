@@ -1,10 +1,15 @@
 #ifndef TRIPLE_OSCILLATOR_P_H__
 #define TRIPLE_OSCILLATOR_P_H__
 
+#include <stdbool.h>
+
 #include "lmms_lv2.h"
 #include "envelope.h"
 #include "lfo.h"
+#include "modulation.h"
 #include "oscillator.h"
+#include "voice.h"
+#include "worker_pool.h"
 
 // max length of each envelope-segment (e.g. attack)
 #define SECS_PER_ENV_SEGMENT 5.0f
@@ -18,8 +23,70 @@
 #define PAN_MAX 100.0f
 #define VOL_MAX 100.0f
 
-#define PITCH_BEND_LAG   (0.5)
-#define PITCH_BEND_RANGE (1.0) // One octave
+// Settings of the quality port
+enum {
+	QUALITY_DRAFT  = 0, // Naive oscillators, filter coefficients per tile
+	QUALITY_NORMAL = 1,
+	QUALITY_HIGH   = 2  // PM/FM chains at least 2x oversampled
+};
+
+// Settings of the voice_mode port
+enum {
+	VOICE_MODE_POLY   = 0, // Every note-on takes a voice
+	VOICE_MODE_REUSE  = 1, // A repeated note retriggers its own voice
+	VOICE_MODE_MONO   = 2, // One voice, retriggered by every note
+	VOICE_MODE_LEGATO = 3  // One voice, overlapping notes only change pitch
+};
+
+// Frames over which live volume changes glide
+#define PARAM_RAMP_LEN 64
+
+// Length of the fade-out when culling an inaudible voice
+#define CULL_FADE_LEN 64
+
+// Scratch of one rendering participant: both channels of a voice and the
+// oversampling work buffer
+#define SCRATCH_LEN (2 * MOD_BLOCK_LEN + OSC_OS_WORK_LEN(MOD_BLOCK_LEN))
+
+// Frames rendered per worker pool dispatch
+#define WORKER_SPAN 256
+// Voices per rendering thread below which the pool isn't worth waking
+#define WORKER_MIN_VOICES 4
+// Frames rendered per dispatch while the host freewheels, where deadlines
+// don't matter and fewer, longer dispatches scale better
+#define FREEWHEEL_SPAN 1024
+// Rendering threads started for freewheeling when no workers are set up
+#define FREEWHEEL_MAX_THREADS 8
+// Longest list of CPUs to pin the workers to
+#define MAX_WORKER_CPUS 64
+
+// Longest host block expected if the host doesn't pass bufsz:maxBlockLength
+#define DEFAULT_MAX_BLOCK 4096
+// Upper bound for bufsz:maxBlockLength, longer blocks aren't pipelined
+#define MAX_BLOCK_LIMIT 65536
+// Coarsest event grid, in frames
+#define MAX_EVENT_GRID 64
+// Room for the events of one block in pipelined mode
+#define PIPELINE_EVENT_BYTES 8192
+// Room for every port index
+#define TRIPOSC_MAX_PORTS 128
+
+// CPU governor.  The render time over the block's real-time budget is
+// smoothed; above GOV_LOAD_HIGH the degrade level steps up, below
+// GOV_LOAD_LOW back down, each after holding there for a while.  Every
+// level takes away a quarter of the polyphony, level 1 and up update
+// filter coefficients once per tile, level 2 and up start new notes with
+// naive, non-oversampled oscillators.
+#define GOV_LEVELS       3
+#define GOV_LOAD_HIGH    0.9f
+#define GOV_LOAD_LOW     0.5f
+#define GOV_SMOOTH_SECS  0.1f  // Time constant of the load average
+#define GOV_DEGRADE_SECS 0.25f // Overload before stepping up
+#define GOV_RECOVER_SECS 2.0f  // Headroom before stepping back down
+
+#define PITCH_BEND_LAG     (0.5)
+#define PITCH_BEND_RANGE   (1.0)  // One octave
+#define PITCH_BEND_EPSILON (1e-6) // Lag distance at which the bend is steady
 
 
 // Per-oscillator ports and calculated coefficients
@@ -36,10 +103,18 @@ typedef struct oscillator_unit {
 	float *wave_shape_port;
 	float *modulation_port;
 
+	// Port values of the last snapshot: vol, pan, detune coarse, fine
+	// left, fine right, phase offset, phase detune
+	float inputs[7];
+
 	// Calculated values
 	float m_volumeLeft;
 	float m_volumeRight;
-	// normalized detuning -> x/sampleRate
+	// unpanned volume and the pan's gain on each side, for mono voices
+	float m_volume;
+	float m_panLeft;
+	float m_panRight;
+	// detuning as a frequency ratio
 	float m_detuningLeft;
 	float m_detuningRight;
 	// normalized offset -> x/360
@@ -52,9 +127,28 @@ typedef struct oscillator_unit {
 typedef struct triposc_generator {
 	Oscillator osc_l[3];
 	Oscillator osc_r[3];
+	float      peak;     // Upper bound of the oscillators' output level
+	float      freq;     // Note frequency, before detuning
+	uint8_t    velocity;
+	bool       mono;     // osc_r is not rendered, the left chain feeds both
+	                     // channels, rendered unpanned and panned after
+	float      pan_l[3]; // While mono: the units' pan gains
+	float      pan_r[3];
+	float      gain_l;   // While mono: the pan gain of the whole chain
+	float      gain_r;
+	bool       naive;    // Render without antialiasing (draft quality)
+	int        oversample;      // PM/FM chain rendering rate, 1 for off
+	OscDecimator dec[2];        // Per channel, when oversampling
 } TripOscGenerator;
 
 
+// All state of one voice in a single cache-line aligned block
+typedef struct triposc_voice {
+	Voice            v;
+	TripOscGenerator g;
+} ALIGNED(CACHE_LINE_SIZE) TripOscVoice;
+
+
 // The entire instrument
 typedef struct triple_oscillator {
 	/* Features */
@@ -69,29 +163,97 @@ typedef struct triple_oscillator {
 	float *filter_type_port;
 	float *filter_cut_port;
 	float *filter_res_port;
+	float *cull_threshold_port;
+	float *polyphony_port;
+	float *pipeline_port;
+	float *latency_port;
+	float *event_grid_port;
+	float *fm_oversample_port;
+	float *quality_port;
+	float *governor_port;
+	float *load_port;
+	float *freewheel_port;
+	float *voice_mode_port;
+	float *active_voices_port;
 
-	EnvelopeParams env_vol_params;
-	EnvelopeParams env_cut_params;
-	EnvelopeParams env_res_params;
+	/* Control inputs as connected by the host.  The ports above point into
+	   controls, copied from these at the start of every run(), so rendering
+	   never reads the host's values after run() has returned. */
+	const float *host_controls[TRIPOSC_MAX_PORTS];
+	float        controls[TRIPOSC_MAX_PORTS];
 
-	LfoParams lfo_vol_params;
-	LfoParams lfo_cut_params;
-	LfoParams lfo_res_params;
+	EnvelopeParams env_params[MOD_NTARGETS];
+	LfoParams      lfo_params[MOD_NTARGETS];
 
 	/* Generic instrument stuff */
-	Voice *voices;
+	TripOscVoice *voices;
+	ModulationEngine *mod;
+	VoicePool pool;
+	uint32_t npool;           // Voices allocated
+
+	/* Keys down, oldest first, for the mono voice modes */
+	uint8_t  held_notes[128];
+	uint8_t  held_velocities[128];
+	uint32_t nheld;
 
 	float  pitch_bend;        // Pitchbend in-value
 	float  pitch_bend_lagged; // Pitchbend out-value
+	bool   pitch_bend_steady; // Out-value has reached the in-value
+
+	/* CPU governor */
+	float  load;              // Smoothed render time over real time
+	float  gov_hold;          // Seconds the load has been past a threshold
+	int    gov_level;         // 0 for full service, up to GOV_LEVELS
+
+	/* Audio buffers of run(), carved from one aligned arena */
+	float      *arena;
+	float      *bendbuf;      // [FREEWHEEL_SPAN]
+	float      *scratch;      // [participant][SCRATCH_LEN]
+	float      *wbuf;         // [worker-1][channel][FREEWHEEL_SPAN]
+	uint32_t    max_block;    // Longest block the host will run
+
+	/* Rendering, shared with the worker threads during a dispatch */
+	WorkerPool *workers;      // NULL when rendering on the host thread only
+	WorkerPool *freewheel_workers; // Used while freewheeling if workers is NULL
+	uint8_t    *finished;     // Per voice: 1 + block it finished in, or 0
+	float       cull_level;   // Level below which releasing voices are culled
+	struct {
+		WorkerPool     *workers;
+		const uint32_t *voices;
+		uint32_t        nvoices;
+		float          *out_l;
+		float          *out_r;
+		uint32_t        pos;
+		uint32_t        nframes;
+		const float    *bend;
+	} job;
+
+	/* Pipelined rendering, one host block ahead on a helper thread */
+	WorkerPool        *pipeline;     // NULL on a single CPU
+	float             *ring;         // [channel][ring_len]
+	float             *stage;        // [channel][max_block, cache-line padded]
+	LV2_Atom_Sequence *pipe_events;  // Events of the block being rendered
+	uint32_t           ring_len;     // Power of two, >= 2 * max_block
+	uint32_t           pipe_nframes;
+	bool               pipe_busy;
+	uint32_t           ring_write;   // Frames rendered, wrapping
+	uint32_t           ring_read;    // Frames handed to the host, wrapping
 
 	/* URIs TODO: Global*/
 	struct {
 		LV2_URID midi_event;
 		LV2_URID atom_message;
+		LV2_URID atom_int;
+		LV2_URID atom_vector;
+		LV2_URID polyphony;
+		LV2_URID worker_threads;
+		LV2_URID worker_cpus;
+		LV2_URID max_block;
 	} uris;
 
 	/* Generator Ports */
 	OscillatorUnit units[3];
+	bool           units_valid; // Calculated values are set
 
 	/* Playback state */
 	uint32_t frame; // TODO: frame_t
@@ -6,10 +6,24 @@
 
 // TODO: Maybe move our instruments out of here and into each plugin's *.h
 #define ENVELOPE_GENERATOR_URI "http://pgiblock.net/plugins/envelope-generator"
+#define ENVELOPE_GENERATOR_POLY_URI "http://pgiblock.net/plugins/envelope-generator-poly"
 #define LB303_SYNTH_URI        "http://pgiblock.net/plugins/lb303-synth"
 #define SID_URI                "http://pgiblock.net/plugins/sid"
 #define TRIPLE_OSCILLATOR_URI  "http://pgiblock.net/plugins/triple-oscillator"
 #define MIDI_EVENT_URI         "http://lv2plug.in/ns/ext/midi#MidiEvent"
 #define ATOM_MESSAGE_URI       "http://lv2plug.in/ns/ext/atom#Message"
+#define ATOM_INT_URI           "http://lv2plug.in/ns/ext/atom#Int"
+#define ATOM_VECTOR_URI        "http://lv2plug.in/ns/ext/atom#Vector"
+
+// Instantiate-time option: number of voices to allocate
+#define POLYPHONY_OPTION_URI   "http://pgiblock.net/ns/lmms#polyphony"
+// Instantiate-time option: number of voice rendering threads besides the
+// host's audio thread
+#define WORKER_THREADS_OPTION_URI "http://pgiblock.net/ns/lmms#workerThreads"
+// Instantiate-time option: vector of ints, CPUs to pin the voice rendering
+// threads to.  Also sets their number if workerThreads isn't given.
+#define WORKER_CPUS_OPTION_URI "http://pgiblock.net/ns/lmms#workerCpus"
+// Host option: longest block run() will be called with
+#define MAX_BLOCK_LENGTH_URI   "http://lv2plug.in/ns/ext/buf-size#maxBlockLength"
 
 #endif //LMMS_LV2_URIS_H__
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+
+#include "voice.h"
+
+
+static void
+list_append (VoiceList *l, Voice *v)
+{
+	v->prev = l->tail;
+	v->next = NULL;
+	if (l->tail) {
+		l->tail->next = v;
+	} else {
+		l->head = v;
+	}
+	l->tail = v;
+	l->count++;
+}
+
+
+static void
+list_remove (VoiceList *l, Voice *v)
+{
+	if (v->prev) {
+		v->prev->next = v->next;
+	} else {
+		l->head = v->next;
+	}
+	if (v->next) {
+		v->next->prev = v->prev;
+	} else {
+		l->tail = v->prev;
+	}
+	v->prev = v->next = NULL;
+	l->count--;
+}
+
+
+// Move a voice to the end of the list for state
+static void
+voice_move (VoicePool *p, Voice *v, uint8_t state)
+{
+	list_remove(&p->lists[v->state], v);
+	list_append(&p->lists[state], v);
+	v->state = state;
+}
+
+
+void
+voice_pool_init (VoicePool *p, void *voices, size_t stride, uint32_t nvoices)
+{
+	uint32_t i;
+
+	p->voices  = voices;
+	p->stride  = stride;
+	p->nvoices = nvoices;
+	for (i = 0; i < VOICE_NSTATES; ++i) {
+		p->lists[i].head  = NULL;
+		p->lists[i].tail  = NULL;
+		p->lists[i].count = 0;
+	}
+	for (i = 0; i < nvoices; ++i) {
+		Voice *v = voice_pool_at(p, i);
+		v->idx   = i;
+		v->state = VOICE_FREE;
+		list_append(&p->lists[VOICE_FREE], v);
+	}
+}
+
+
+// Take a voice for a new note, stealing one if limit voices are active.
+// The voice is returned as the newest held voice.
+Voice *
+voice_pool_alloc (VoicePool *p, uint32_t limit)
+{
+	Voice *v;
+
+	if (voice_pool_active(p) < limit && p->lists[VOICE_FREE].head) {
+		v = p->lists[VOICE_FREE].head;
+	} else if (p->lists[VOICE_RELEASING].head) {
+		v = p->lists[VOICE_RELEASING].head;
+	} else if (p->lists[VOICE_HELD].head) {
+		v = p->lists[VOICE_HELD].head;
+	} else {
+		// Only when limit is 0
+		v = p->lists[VOICE_FREE].head;
+	}
+
+	voice_move(p, v, VOICE_HELD);
+	return v;
+}
+
+
+// Newest active voice playing midi_note, held ones first, or NULL
+Voice *
+voice_pool_find (const VoicePool *p, uint8_t midi_note)
+{
+	Voice *v;
+
+	for (int l = VOICE_HELD; l <= VOICE_RELEASING; ++l) {
+		for (v = p->lists[l].tail; v; v = v->prev) {
+			if (v->midi_note == midi_note) {
+				return v;
+			}
+		}
+	}
+	return NULL;
+}
+
+
+// Newest active voice, held ones first, or NULL
+Voice *
+voice_pool_newest (const VoicePool *p)
+{
+	return p->lists[VOICE_HELD].tail ? p->lists[VOICE_HELD].tail
+	                                 : p->lists[VOICE_RELEASING].tail;
+}
+
+
+// Restart an active voice for a new note, as the newest held voice
+void
+voice_pool_retrigger (VoicePool *p, Voice *v)
+{
+	voice_move(p, v, VOICE_HELD);
+}
+
+
+void
+voice_pool_release (VoicePool *p, Voice *v)
+{
+	if (v->state == VOICE_HELD) {
+		voice_move(p, v, VOICE_RELEASING);
+	}
+}
+
+
+void
+voice_pool_free (VoicePool *p, Voice *v)
+{
+	if (v->state != VOICE_FREE) {
+		voice_move(p, v, VOICE_FREE);
+	}
+}
@@ -2,31 +2,90 @@
 #define VOICE_H__
 
 #include "basic_filters.h"
-#include "envelope.h"
-#include "lfo.h"
+
+// Voice states, each with its own list in the VoicePool
+enum {
+	VOICE_FREE,      // Not playing
+	VOICE_HELD,      // Note is held
+	VOICE_RELEASING, // Note released, still sounding
+	VOICE_NSTATES
+};
 
 typedef struct voice {
 	// Standard voice state
 	uint8_t    midi_note;
+	uint8_t    state;
+	uint32_t   idx;       // Index in the pool
 	uint32_t   frame;
+	uint32_t   fade;      // Frames left of a cull fade-out, 0 if none
+	uint32_t   delay;     // Frames until a quantized note-on really starts
+	uint8_t    release;   // Note-off came in before the delayed note-on started
+
+	// Intrusive links of the list for the voice's state
+	struct voice *prev;
+	struct voice *next;
 
-	// Generator
-	// TODO: Reverse this relationship?? TripOscVoice contain some VoiceState struct?
-	void *generator;
+	// Generators embed Voice as their first member, so a voice and its
+	// generator state are one contiguous block.
 
-	// Volume Envelope TODO: Remove from generic Voice?
-	Envelope  *env_vol;
-	Lfo       *lfo_vol;
+	// Envelopes and LFOs live in the instrument's ModulationEngine
 
-	// Filter envelopes and state
-	Envelope  *env_cut;
-	Lfo       *lfo_cut;
-	Envelope  *env_res;
-	Lfo       *lfo_res;
-	Filter    *filter;
+	// Filter state
+	Filter     filter;
 
 	// TODO: Function pointers for processing the voice
 	
 } Voice;
 
+
+// Doubly-linked list of voices, oldest first
+typedef struct voice_list {
+	Voice    *head;
+	Voice    *tail;
+	uint32_t  count;
+} VoiceList;
+
+
+// Voices of an instrument, kept on one list per state.  The held and
+// releasing lists are ordered by age, so stealing is O(1): the oldest
+// releasing voice goes first, then the oldest held one.
+typedef struct voice_pool {
+	char      *voices;   // Array of generator voices embedding Voice
+	size_t     stride;   // Size of one generator voice
+	uint32_t   nvoices;
+	VoiceList  lists[VOICE_NSTATES];
+} VoicePool;
+
+
+void voice_pool_init (VoicePool *p, void *voices, size_t stride, uint32_t nvoices);
+
+Voice *voice_pool_alloc (VoicePool *p, uint32_t limit);
+Voice *voice_pool_find (const VoicePool *p, uint8_t midi_note);
+Voice *voice_pool_newest (const VoicePool *p);
+void voice_pool_retrigger (VoicePool *p, Voice *v);
+void voice_pool_release (VoicePool *p, Voice *v);
+void voice_pool_free (VoicePool *p, Voice *v);
+
+
+// Number of held and releasing voices
+static inline uint32_t
+voice_pool_active (const VoicePool *p)
+{
+	return p->lists[VOICE_HELD].count + p->lists[VOICE_RELEASING].count;
+}
+
+
+static inline Voice *
+voice_pool_at (const VoicePool *p, uint32_t idx)
+{
+	return (Voice *)(p->voices + idx * p->stride);
+}
+
+
+static inline uint32_t
+voice_index (const VoicePool *p, const Voice *v)
+{
+	return v->idx;
+}
+
 #endif
@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "worker_pool.h"
+
+// Iterations a worker spins for the next job before parking, and the
+// caller for a job to finish before blocking.  Kept short, as either may
+// hold up the other when they share a CPU.
+#define WORKER_SPIN_ITERS 2000
+
+#if defined(__i386__) || defined(__x86_64__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() do { } while (0)
+#endif
+
+
+typedef struct worker {
+	WorkerPool *pool;
+	uint32_t    id;
+	int         cpu;        // -1 if not pinned
+	pthread_t   thread;
+	sem_t       wake;
+	int         parked;     // Set while waiting on wake
+	uint32_t    seen;       // Last generation run
+	uint32_t    sched_seen; // Last scheduling generation taken on
+} Worker;
+
+
+struct worker_pool {
+	uint32_t    nthreads;
+	Worker     *workers;
+
+	// Job, published by bumping generation
+	WorkerFunc  func;
+	void       *arg;
+	uint32_t    generation;
+	uint32_t    pending;    // Workers still running the job
+	int         quit;
+
+	// Caller waiting on done for the job to finish
+	sem_t       done;
+	int         waiting;
+
+	// Scheduling of the thread starting jobs, which the workers take on.
+	// Published by bumping sched_generation.
+	int         have_runner;
+	pthread_t   runner;
+	int         policy;
+	int         priority;
+	uint32_t    sched_generation;
+};
+
+
+// Wait for a new generation: spin first, then park on the semaphore
+static void
+worker_wait (Worker *w)
+{
+	WorkerPool *p = w->pool;
+	uint32_t g;
+	int i;
+
+	for (;;) {
+		for (i = 0; i < WORKER_SPIN_ITERS; ++i) {
+			g = __atomic_load_n(&p->generation, __ATOMIC_ACQUIRE);
+			if (g != w->seen) {
+				w->seen = g;
+				return;
+			}
+			cpu_relax();
+		}
+
+		__atomic_store_n(&w->parked, 1, __ATOMIC_SEQ_CST);
+		g = __atomic_load_n(&p->generation, __ATOMIC_SEQ_CST);
+		if (g != w->seen) {
+			// Raced with a new job.  If the runner already cleared the
+			// flag it has posted too, so consume that post.
+			if (!__atomic_exchange_n(&w->parked, 0, __ATOMIC_SEQ_CST)) {
+				while (sem_wait(&w->wake) && errno == EINTR);
+			}
+			w->seen = g;
+			return;
+		}
+		while (sem_wait(&w->wake) && errno == EINTR);
+	}
+}
+
+
+// Run at the scheduling policy and priority of the thread starting the
+// jobs, so a worker sharing its CPU neither starves nor preempts it
+static void
+worker_adopt_sched (Worker *w)
+{
+	WorkerPool *p = w->pool;
+	const uint32_t g = __atomic_load_n(&p->sched_generation, __ATOMIC_ACQUIRE);
+	struct sched_param sp;
+
+	if (g == w->sched_seen) {
+		return;
+	}
+	w->sched_seen = g;
+	sp.sched_priority = p->priority;
+	if (pthread_setschedparam(pthread_self(), p->policy, &sp)) {
+		fprintf(stderr, "lmms-lv2: Could not set worker priority to %d.\n", p->priority);
+	}
+}
+
+
+static void *
+worker_main (void *data)
+{
+	Worker *w = (Worker *)data;
+	WorkerPool *p = w->pool;
+
+	if (w->cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(w->cpu, &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+			fprintf(stderr, "lmms-lv2: Could not pin worker to CPU %d.\n", w->cpu);
+		}
+	}
+
+	for (;;) {
+		worker_wait(w);
+		if (__atomic_load_n(&p->quit, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+		worker_adopt_sched(w);
+		p->func(p->arg, w->id);
+
+		// The last one out wakes the caller if it has stopped spinning
+		if (!__atomic_sub_fetch(&p->pending, 1, __ATOMIC_SEQ_CST) &&
+		    __atomic_exchange_n(&p->waiting, 0, __ATOMIC_SEQ_CST)) {
+			sem_post(&p->done);
+		}
+	}
+	return NULL;
+}
+
+
+// Wake all parked workers
+static void
+worker_pool_wake (WorkerPool *p)
+{
+	uint32_t i;
+
+	for (i = 0; i < p->nthreads; ++i) {
+		Worker *w = &p->workers[i];
+		if (__atomic_exchange_n(&w->parked, 0, __ATOMIC_SEQ_CST)) {
+			sem_post(&w->wake);
+		}
+	}
+}
+
+
+WorkerPool *
+worker_pool_create (uint32_t nthreads, const int *cpus, uint32_t ncpus)
+{
+	WorkerPool *p = calloc(1, sizeof(WorkerPool));
+	uint32_t i;
+
+	if (!p) {
+		return NULL;
+	}
+
+	// A worker can only ever take the CPU from the caller on one CPU
+	if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+		nthreads = 0;
+	}
+
+	p->workers = calloc(nthreads, sizeof(Worker));
+	if (nthreads && !p->workers) {
+		free(p);
+		return NULL;
+	}
+	sem_init(&p->done, 0, 0);
+
+	for (i = 0; i < nthreads; ++i) {
+		Worker *w = &p->workers[i];
+		w->pool = p;
+		w->id   = i + 1;
+		w->cpu  = (cpus && ncpus) ? cpus[i % ncpus] : -1;
+		sem_init(&w->wake, 0, 0);
+		if (pthread_create(&w->thread, NULL, worker_main, w)) {
+			fprintf(stderr, "lmms-lv2: Could not start worker thread.\n");
+			sem_destroy(&w->wake);
+			break;
+		}
+	}
+	p->nthreads = i;
+	return p;
+}
+
+
+void
+worker_pool_destroy (WorkerPool *p)
+{
+	uint32_t i;
+
+	__atomic_store_n(&p->quit, 1, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&p->generation, 1, __ATOMIC_SEQ_CST);
+	worker_pool_wake(p);
+
+	for (i = 0; i < p->nthreads; ++i) {
+		pthread_join(p->workers[i].thread, NULL);
+		sem_destroy(&p->workers[i].wake);
+	}
+	sem_destroy(&p->done);
+	free(p->workers);
+	free(p);
+}
+
+
+uint32_t
+worker_pool_size (const WorkerPool *p)
+{
+	return p->nthreads + 1;
+}
+
+
+void
+worker_pool_start (WorkerPool *p, WorkerFunc func, void *arg)
+{
+	const pthread_t self = pthread_self();
+
+	// Look up the caller's scheduling only when the calling thread changes,
+	// e.g. on the first job or when the host starts freewheeling
+	if (!p->have_runner || !pthread_equal(self, p->runner)) {
+		struct sched_param sp;
+		if (!pthread_getschedparam(self, &p->policy, &sp)) {
+			p->priority = sp.sched_priority;
+			__atomic_add_fetch(&p->sched_generation, 1, __ATOMIC_RELEASE);
+		}
+		p->runner      = self;
+		p->have_runner = 1;
+	}
+
+	p->func = func;
+	p->arg  = arg;
+	__atomic_store_n(&p->pending, p->nthreads, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&p->generation, 1, __ATOMIC_SEQ_CST);
+	worker_pool_wake(p);
+}
+
+
+void
+worker_pool_wait (WorkerPool *p)
+{
+	int i;
+
+	for (i = 0; i < WORKER_SPIN_ITERS; ++i) {
+		if (!__atomic_load_n(&p->pending, __ATOMIC_ACQUIRE)) {
+			return;
+		}
+		cpu_relax();
+	}
+
+	// Block, giving the CPU to any worker that shares it
+	__atomic_store_n(&p->waiting, 1, __ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&p->pending, __ATOMIC_SEQ_CST)) {
+		// Finished meanwhile.  If the last worker already cleared the
+		// flag it has posted too, so consume that post.
+		if (!__atomic_exchange_n(&p->waiting, 0, __ATOMIC_SEQ_CST)) {
+			while (sem_wait(&p->done) && errno == EINTR);
+		}
+		return;
+	}
+	while (sem_wait(&p->done) && errno == EINTR);
+}
+
+
+void
+worker_pool_run (WorkerPool *p, WorkerFunc func, void *arg)
+{
+	// Do our own share, then wait for the rest
+	worker_pool_start(p, func, arg);
+	func(arg, 0);
+	worker_pool_wait(p);
+}
@@ -0,0 +1,34 @@
+#ifndef WORKER_POOL_H__
+#define WORKER_POOL_H__
+
+#include <stdint.h>
+
+// Job function, called once on every participant of a run.  Participant 0
+// is the thread calling worker_pool_run(), 1..n are the pool's threads.
+typedef void (*WorkerFunc) (void *arg, uint32_t participant);
+
+typedef struct worker_pool WorkerPool;
+
+
+// Start nthreads workers, or none when only one CPU is online.  When cpus
+// is non-NULL, worker i is pinned to cpus[i % ncpus].
+WorkerPool *worker_pool_create (uint32_t nthreads, const int *cpus, uint32_t ncpus);
+
+void worker_pool_destroy (WorkerPool *p);
+
+// Number of participants in a run, including the caller
+uint32_t worker_pool_size (const WorkerPool *p);
+
+// Run func on all participants and return when all have finished.  Does
+// not lock or allocate; parked workers are woken with a semaphore post,
+// and the caller blocks on one if they take long.  The workers take on the scheduling policy and priority of the thread
+// starting the job.
+void worker_pool_run (WorkerPool *p, WorkerFunc func, void *arg);
+
+// Start func on the pool's threads only and return immediately.  The job
+// must be finished with worker_pool_wait() before the next one is started,
+// which spins briefly and then blocks.
+void worker_pool_start (WorkerPool *p, WorkerFunc func, void *arg);
+void worker_pool_wait (WorkerPool *p);
+
+#endif // WORKER_POOL_H__
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lmms_lv2.h"
+#include "uris.h"
+#include "triple_oscillator.h"
+#include "instrument_ports.h"
+#include "std_instrument_ports.h"
+#include "triple_oscillator_ports.h"
+
+#define NPORTS   128
+#define SRATE    44100.0
+#define CHORD_LEN 2048 // Frames from one chord to the next
+
+char *program_name;
+
+static char uris[16][128];
+static int  nuris;
+
+// Minimal URID map for the benchmark
+static LV2_URID
+map_uri (LV2_URID_Map_Handle handle, const char *uri)
+{
+	int i;
+	for (i=0; i<nuris; ++i) {
+		if (!strcmp(uris[i], uri)) {
+			return i + 1;
+		}
+	}
+	strncpy(uris[nuris], uri, sizeof(uris[0]) - 1);
+	return ++nuris;
+}
+
+void
+usage ()
+{
+	fprintf(stderr, "Usage: %s block_size nblocks polyphony filter\n",
+	        program_name);
+	exit(1);
+}
+
+int
+parse_int (char *s, char *n)
+{
+	int i;
+	if (sscanf(s, "%d", &i) == 1) {
+		return i;
+	} else {
+		fprintf(stderr, "%s: Could not parse %s\n", program_name, n);
+		usage();
+		return 0;
+	}
+}
+
+// Append a 3 byte MIDI event to a sequence
+static void
+seq_midi (LV2_Atom_Sequence *seq, uint32_t frame, uint32_t type,
+          uint8_t cmd, uint8_t d1, uint8_t d2)
+{
+	LV2_Atom_Event *ev = (LV2_Atom_Event *)((uint8_t *)seq + sizeof(LV2_Atom) +
+	                     lv2_atom_pad_size(seq->atom.size));
+	uint8_t *data = (uint8_t *)(ev + 1);
+
+	ev->time.frames = frame;
+	ev->body.type   = type;
+	ev->body.size   = 3;
+	data[0] = cmd;
+	data[1] = d1;
+	data[2] = d2;
+	seq->atom.size = lv2_atom_pad_size(seq->atom.size) + sizeof(LV2_Atom_Event) + 3;
+}
+
+int
+main (int argc, char **argv)
+{
+	uint64_t seqbuf[512];
+	LV2_Atom_Sequence *seq = (LV2_Atom_Sequence *)seqbuf;
+	float ports[NPORTS];
+	float *out_l, *out_r;
+	int block_size, nblocks, polyphony, filter;
+	int b, f, i, o;
+	uint32_t midi_event;
+	struct timespec t0, t1;
+	double secs;
+
+	program_name = argv[0];
+
+	if (argc != 5) {
+		usage();
+	}
+
+	block_size = parse_int(argv[1], "block_size");
+	nblocks    = parse_int(argv[2], "nblocks");
+	polyphony  = parse_int(argv[3], "polyphony");
+	filter     = parse_int(argv[4], "filter");
+
+	if (block_size <= 0 || nblocks <= 0 || polyphony <= 0) {
+		fprintf(stderr, "%s: arguments must be positive\n", program_name);
+		usage();
+	}
+
+	LV2_URID_Map map = { NULL, map_uri };
+	LV2_Feature map_feature = { LV2_URID__map, &map };
+	const LV2_Feature *features[] = { &map_feature, NULL };
+	const LV2_Descriptor *d = &triple_oscillator_descriptor;
+
+	midi_event = map_uri(NULL, MIDI_EVENT_URI);
+
+	LV2_Handle h = d->instantiate(d, SRATE, "", features);
+	if (!h) {
+		return EXIT_FAILURE;
+	}
+
+	// Saw, square and moog saw mixed, through the filter, with envelope and LFO
+	memset(ports, 0, sizeof(ports));
+	for (o=0; o<3; ++o) {
+		const int osc = o * (PORT_OSC2_VOL - PORT_OSC1_VOL);
+		ports[PORT_OSC1_VOL + osc]        = 33.0f;
+		ports[PORT_OSC1_WAVE_SHAPE + osc] = 2 + o;
+		if (o < 2) {
+			ports[PORT_OSC1_OSC2_MOD + osc] = 2.0f; // Mix
+		}
+	}
+	ports[PORT_ENV_VOL_ATT]    = 0.01f;
+	ports[PORT_ENV_VOL_DEC]    = 0.2f;
+	ports[PORT_ENV_VOL_SUS]    = 0.5f;
+	ports[PORT_ENV_VOL_REL]    = 0.3f;
+	ports[PORT_ENV_VOL_MOD]    = 1.0f;
+	ports[PORT_LFO_CUT_SPD]    = 0.1f;
+	ports[PORT_LFO_CUT_MOD]    = 0.2f;
+	ports[PORT_FILTER_ENABLED] = filter;
+	ports[PORT_FILTER_CUT]     = 2000.0f;
+	ports[PORT_FILTER_RES]     = 0.5f;
+	ports[PORT_CULL_THRESHOLD] = -90.0f;
+	ports[PORT_POLYPHONY]      = polyphony;
+	ports[PORT_FM_OVERSAMPLE]  = 1.0f;
+	ports[PORT_QUALITY]        = 1.0f; // Normal
+
+	out_l = malloc(sizeof(float) * block_size);
+	out_r = malloc(sizeof(float) * block_size);
+
+	d->connect_port(h, PORT_CONTROL, seq);
+	d->connect_port(h, PORT_OUT_L, out_l);
+	d->connect_port(h, PORT_OUT_R, out_r);
+	for (i=PORT_OUT_R+1; i<NPORTS; ++i) {
+		d->connect_port(h, i, &ports[i]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	// Keep the polyphony busy: a new four note chord every CHORD_LEN
+	// frames, released half way, whatever the block size
+	for (b=0; b<nblocks; ++b) {
+		seq->atom.type = 0;
+		seq->atom.size = sizeof(LV2_Atom_Sequence_Body);
+		for (f=0; f<block_size; ++f) {
+			const int frame = b * block_size + f;
+			const int chord = frame / CHORD_LEN;
+			if (frame % (CHORD_LEN / 2) || seq->atom.size > sizeof(seqbuf) / 2) {
+				continue;
+			}
+			for (i=0; i<4; ++i) {
+				const uint8_t note = 36 + (chord * 5 + i * 7) % 60;
+				if (frame % CHORD_LEN == 0) {
+					seq_midi(seq, f, midi_event, 0x90, note, 100);
+				} else {
+					seq_midi(seq, f, midi_event, 0x80, note, 0);
+				}
+			}
+		}
+		d->run(h, block_size);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+	printf("tile=%d block=%d polyphony=%d filter=%d: %.3f s, %.2f us/block, %.1fx realtime\n",
+	       TILE_SIZE, block_size, polyphony, filter, secs,
+	       secs * 1e6 / nblocks,
+	       (double)block_size * nblocks / SRATE / secs);
+
+	d->cleanup(h);
+	free(out_l);
+	free(out_r);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "envelope.h"
+
+#define BUFSIZE 1024
+
+char *program_name;
+
+void
+usage ()
+{
+	fprintf(stderr, "Usage: %s nsamples release del att hold dec sus rel mod\n",
+	        program_name);
+	exit(1);
+}
+
+float
+parse_float (char *s, char *n)
+{
+	float f;
+	if (sscanf(s, "%f", &f) == 1) {
+		return f;
+	} else {
+		fprintf(stderr, "%s: Could not parse %s\n", program_name, n);
+		usage();
+		return 0;
+	}
+}
+
+int
+parse_int (char *s, char *n)
+{
+	int i;
+	if (sscanf(s, "%d", &i) == 1) {
+		return i;
+	} else {
+		fprintf(stderr, "%s: Could not parse %s\n", program_name, n);
+		usage();
+		return 0;
+	}
+}
+
+int
+main (int argc, char **argv)
+{
+	float outbuf[BUFSIZE];
+	float del, att, hold, dec, sus, rel, mod;
+	int nsamples, release, s, i, len;
+
+	program_name = argv[0];
+
+	if (argc != 10) {
+		usage();
+	}
+
+	nsamples = parse_int(argv[1], "nsamples");
+	release  = parse_int(argv[2], "release");
+	del  = parse_float(argv[3], "del");
+	att  = parse_float(argv[4], "att");
+	hold = parse_float(argv[5], "hold");
+	dec  = parse_float(argv[6], "dec");
+	sus  = parse_float(argv[7], "sus");
+	rel  = parse_float(argv[8], "rel");
+	mod  = parse_float(argv[9], "mod");
+
+	if (!nsamples) {
+		fprintf(stderr, "%s: nsamples must be nonzero\n", program_name);
+		usage();
+	}
+
+	// Seconds * samples/second = samples
+	EnvelopeParams p = {48000.0f, &del, &att, &hold, &dec, &sus, &rel, &mod};
+	Envelope *env = envelope_create(&p);
+
+	envelope_trigger(env);
+
+	for (s = 0; s < nsamples;) {
+		// Run up to the release frame, or a full buffer
+		len = BUFSIZE;
+		if (s < release && release - s < len) {
+			len = release - s;
+		}
+		if (s == release) {
+			envelope_release(env);
+		}
+
+		envelope_run(env, outbuf, len);
+
+		// Write
+		for (i = 0; i < len && s < nsamples; ++i, ++s)
+			printf("%d %f\n", s, outbuf[i]);
+	}
+
+	envelope_destroy(env);
+	return EXIT_SUCCESS;
+}
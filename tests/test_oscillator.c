@@ -31,7 +31,7 @@ main (int argc, char **argv)
 
 	// RUN
 	for (i=0; i<NPERIODS*NSAMPLES;) {
-		osc_aa_update(&osc, outbuf, bendbuf, NSAMPLES);
+		osc_aa_update(&osc, outbuf, bendbuf, 1.0f, NSAMPLES);
 		for (j=0; j<NSAMPLES; j++, i++) {
 			printf("%d %f\n", i, outbuf[j]);
 		}
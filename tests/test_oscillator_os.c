@@ -0,0 +1,164 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "oscillator.h"
+
+// Renders oscillator chains at 1x and oversampled, and checks that both
+// come out at the same pitch.
+
+#define SRATE    44100.0f
+#define BLOCK    64
+#define NSAMPLES 8192
+#define SKIP     1024
+
+// Lags searched for the period, in frames.  Both chains repeat at 110Hz,
+// about 401 frames.
+#define MIN_LAG  150
+#define MAX_LAG  600
+
+
+// Set up a chain of three oscillators, top first
+static void
+chain_init (Oscillator *o, const int *shapes, const int *mods, const float *freqs)
+{
+	int i;
+
+	for (i = 2; i >= 0; --i) {
+		osc_reset(&o[i], shapes[i], mods[i], freqs[i], 1.0f,
+		          i == 2 ? NULL : &o[i+1], 0.0f, SRATE);
+		osc_seed_noise(&o[i], 1);
+	}
+}
+
+
+// Render the chain into out, at factor times the rate if factor > 1
+static void
+chain_render (Oscillator *o, int factor, float *out)
+{
+	static float work[OSC_OS_WORK_LEN(BLOCK)];
+	OscDecimator d;
+	int pos;
+
+	osc_decimator_reset(&d);
+	for (pos = 0; pos < NSAMPLES; pos += BLOCK) {
+		if (factor > 1) {
+			osc_aa_update_os(o, &d, out + pos, work, NULL, 1.0f, BLOCK, factor);
+		} else {
+			osc_aa_update(o, out + pos, NULL, 1.0f, BLOCK);
+		}
+	}
+}
+
+
+// Shortest lag where the signal matches itself nearly as well as it does
+// anywhere, so a pattern repeating twice as often isn't taken for the same
+static int
+find_period (const float *x)
+{
+	const int n = NSAMPLES - SKIP - MAX_LAG;
+	float corr[MAX_LAG];
+	float best = -2.0f;
+	int   lag, i;
+
+	for (lag = MIN_LAG; lag < MAX_LAG; ++lag) {
+		double xy = 0.0, xx = 0.0, yy = 0.0;
+		for (i = SKIP; i < SKIP + n; ++i) {
+			xy += x[i] * x[i+lag];
+			xx += x[i] * x[i];
+			yy += x[i+lag] * x[i+lag];
+		}
+		corr[lag] = (xx > 0.0 && yy > 0.0) ? xy / sqrt(xx * yy) : 0.0f;
+		if (corr[lag] > best) {
+			best = corr[lag];
+		}
+	}
+	for (lag = MIN_LAG + 1; lag < MAX_LAG - 1; ++lag) {
+		if (corr[lag] >= 0.95f * best &&
+		    corr[lag] >= corr[lag-1] && corr[lag] >= corr[lag+1]) {
+			return lag;
+		}
+	}
+	return 0;
+}
+
+
+static int
+check (const char *name, const int *shapes, const int *mods, const float *freqs)
+{
+	static float out[NSAMPLES];
+	Oscillator o[3];
+	int period[3];
+	int factor, failed = 0;
+
+	for (factor = 1; factor <= OSC_MAX_OVERSAMPLE; factor *= 2) {
+		chain_init(o, shapes, mods, freqs);
+		chain_render(o, factor, out);
+		period[factor / 2] = find_period(out);
+	}
+
+	for (factor = 2; factor <= OSC_MAX_OVERSAMPLE; factor *= 2) {
+		const int p = period[factor / 2];
+		printf("%s: period %d at 1x, %d at %dx\n", name, period[0], p, factor);
+		// Within 2%, the decimation filter smooths the PM a bit
+		if (abs(p - period[0]) * 50 > period[0]) {
+			failed = 1;
+		}
+	}
+	return failed;
+}
+
+
+// Frequency of a sine above C9, which every rate must clamp to C9
+static int
+check_clamp (float freq)
+{
+	static float out[NSAMPLES];
+	const int   shapes[] = { OSC_WAVE_SINE, OSC_WAVE_SINE, OSC_WAVE_SINE };
+	const int   mods[]   = { OSC_MOD_MIX, OSC_MOD_MIX, OSC_MOD_MIX };
+	const float freqs[]  = { freq, 0.0f, 0.0f };
+	Oscillator o[3];
+	int factor, failed = 0;
+
+	for (factor = 1; factor <= OSC_MAX_OVERSAMPLE; factor *= 2) {
+		int i, crossings = 0;
+		float measured;
+
+		chain_init(o, shapes, mods, freqs);
+		o[1].volume = o[2].volume = 0.0f;
+		chain_render(o, factor, out);
+		for (i = SKIP + 1; i < NSAMPLES; ++i) {
+			crossings += out[i-1] < 0.0f && out[i] >= 0.0f;
+		}
+		measured = crossings * SRATE / (NSAMPLES - SKIP - 1);
+
+		printf("clamp: %.0fHz plays at %.0fHz at %dx\n", freq, measured, factor);
+		if (fabsf(measured - OSC_AA_MAX_FREQ) > 0.02f * OSC_AA_MAX_FREQ) {
+			failed = 1;
+		}
+	}
+	return failed;
+}
+
+
+int
+main (int argc, char **argv)
+{
+	// Saw synced to a 110Hz sine
+	const int   sync_shapes[] = { OSC_WAVE_SAW, OSC_WAVE_SINE, OSC_WAVE_SINE };
+	const int   sync_mods[]   = { OSC_MOD_SYNC, OSC_MOD_MIX, OSC_MOD_MIX };
+	const float sync_freqs[]  = { 500.0f, 110.0f, 220.0f };
+
+	// Sine phase modulated by a saw, synced to a 110Hz sine
+	const int   pm_shapes[] = { OSC_WAVE_SINE, OSC_WAVE_SAW, OSC_WAVE_SINE };
+	const int   pm_mods[]   = { OSC_MOD_PM, OSC_MOD_SYNC, OSC_MOD_MIX };
+	const float pm_freqs[]  = { 440.0f, 330.0f, 110.0f };
+
+	int failed = 0;
+
+	failed |= check("sync", sync_shapes, sync_mods, sync_freqs);
+	failed |= check("pm-sync", pm_shapes, pm_mods, pm_freqs);
+	failed |= check_clamp(12000.0f);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}